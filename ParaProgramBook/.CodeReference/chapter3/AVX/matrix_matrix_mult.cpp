@@ -2,9 +2,15 @@
 #include <cstdint>      // uint32_t
 #include <iostream>     // std::cout
 #include <immintrin.h>  // AVX intrinsics
+#include <omp.h>        // omp_get_thread_num
+#include <vector>       // std::vector
 
 // timers distributed with this book
 #include "../include/hpc_helpers.hpp"
+// aligned, huge page backed and NUMA placed memory
+#include "../include/aligned_buffer.hpp"
+// THREAD_PIN_POLICY and the cpu placements
+#include "../include/cpu_topology.hpp"
 
 void init(float * data, uint64_t length) {
 
@@ -30,6 +36,29 @@ inline float hsum_avx(__m256 v) {
     return hsum_sse3(lo);                    // and inline the sse3 version
 }
 
+// the cpu of every OpenMP thread, empty if they are not pinned
+std::vector<uint32_t> omp_placement;
+
+// place the OpenMP threads, one_per_core also shrinks the team so that
+// no two hyperthreads of a core compete for its AVX units
+void place_openmp_threads(pin_policy_t policy) {
+
+    if (policy == pin_policy_t::none)
+        return;
+    if (policy == pin_policy_t::one_per_core)
+        omp_set_num_threads(cpu_topology().num_cores());
+
+    omp_placement = cpu_topology().placement(policy, omp_get_max_threads());
+}
+
+// called by every thread of a compute region: pinning in a separate
+// region would rely on the runtime reusing the same threads
+void pin_openmp_thread() {
+    const uint64_t id = omp_get_thread_num();
+    if (id < omp_placement.size())
+        pin_this_thread(omp_placement[id]);
+}
+
 void plain_dmm(float * A,
                float * B,
                float * C,
@@ -38,14 +67,19 @@ void plain_dmm(float * A,
                uint64_t N,
                bool parallel) {
 
-    #pragma omp parallel for collapse(2) if(parallel)
-    for (uint64_t i = 0; i < M; i++)
-        for (uint64_t j = 0; j < N; j++) {
-            float accum = float(0);
-            for (uint64_t k = 0; k < L; k++)
-                accum += A[i*L+k]*B[j*L+k];
-            C[i*N+j] = accum;
-       }
+    #pragma omp parallel if(parallel)
+    {
+        pin_openmp_thread();
+
+        #pragma omp for collapse(2)
+        for (uint64_t i = 0; i < M; i++)
+            for (uint64_t j = 0; j < N; j++) {
+                float accum = float(0);
+                for (uint64_t k = 0; k < L; k++)
+                    accum += A[i*L+k]*B[j*L+k];
+                C[i*N+j] = accum;
+           }
+    }
 }
 
 void avx_dmm(float * A,
@@ -56,19 +90,24 @@ void avx_dmm(float * A,
              uint64_t N,
              bool parallel) {
 
-    #pragma omp parallel for collapse(2) if(parallel)
-    for (uint64_t i = 0; i < M; i++)
-        for (uint64_t j = 0; j < N; j++) {
+    #pragma omp parallel if(parallel)
+    {
+        pin_openmp_thread();
 
-            __m256 X = _mm256_setzero_ps();
-            for (uint64_t k = 0; k < L; k += 8) {
-                const __m256 AV = _mm256_load_ps(A+i*L+k);
-                const __m256 BV = _mm256_load_ps(B+j*L+k);
-                X = _mm256_add_ps(X, _mm256_mul_ps(AV, BV));
-            }
+        #pragma omp for collapse(2)
+        for (uint64_t i = 0; i < M; i++)
+            for (uint64_t j = 0; j < N; j++) {
 
-            C[i*N+j] = hsum_avx(X);
-       }
+                __m256 X = _mm256_setzero_ps();
+                for (uint64_t k = 0; k < L; k += 8) {
+                    const __m256 AV = _mm256_load_ps(A+i*L+k);
+                    const __m256 BV = _mm256_load_ps(B+j*L+k);
+                    X = _mm256_add_ps(X, _mm256_mul_ps(AV, BV));
+                }
+
+                C[i*N+j] = hsum_avx(X);
+           }
+    }
 }
 
 void avx_dmm_unroll_2(float * A,
@@ -79,23 +118,28 @@ void avx_dmm_unroll_2(float * A,
                       uint64_t N,
                       bool parallel) {
 
-    #pragma omp parallel for collapse(2) if(parallel)
-    for (uint64_t i = 0; i < M; i++)
-        for (uint64_t j = 0; j < N; j++) {
-
-            __m256 X = _mm256_setzero_ps();
-            __m256 Y = _mm256_setzero_ps();
-            for (uint64_t k = 0; k < L; k += 16) {
-                const __m256 AVX = _mm256_load_ps(A+i*L+k+0);
-                const __m256 BVX = _mm256_load_ps(B+j*L+k+0);
-                const __m256 AVY = _mm256_load_ps(A+i*L+k+8);
-                const __m256 BVY = _mm256_load_ps(B+j*L+k+8);
-                X = _mm256_add_ps(X, _mm256_mul_ps(AVX, BVX));
-                Y = _mm256_add_ps(X, _mm256_mul_ps(AVY, BVY));
-            }
-
-            C[i*N+j] = hsum_avx(X)+hsum_avx(Y);
-       }
+    #pragma omp parallel if(parallel)
+    {
+        pin_openmp_thread();
+
+        #pragma omp for collapse(2)
+        for (uint64_t i = 0; i < M; i++)
+            for (uint64_t j = 0; j < N; j++) {
+
+                __m256 X = _mm256_setzero_ps();
+                __m256 Y = _mm256_setzero_ps();
+                for (uint64_t k = 0; k < L; k += 16) {
+                    const __m256 AVX = _mm256_load_ps(A+i*L+k+0);
+                    const __m256 BVX = _mm256_load_ps(B+j*L+k+0);
+                    const __m256 AVY = _mm256_load_ps(A+i*L+k+8);
+                    const __m256 BVY = _mm256_load_ps(B+j*L+k+8);
+                    X = _mm256_add_ps(X, _mm256_mul_ps(AVX, BVX));
+                    Y = _mm256_add_ps(X, _mm256_mul_ps(AVY, BVY));
+                }
+
+                C[i*N+j] = hsum_avx(X)+hsum_avx(Y);
+           }
+    }
 }
 
 int main () {
@@ -104,44 +148,46 @@ int main () {
     const uint64_t L = 1UL <<  11;
     const uint64_t N = 1UL <<  12;
 
+    place_openmp_threads(pin_policy_from_env());
+
     TIMERSTART(alloc_memory)
-    auto A = static_cast<float*>(_mm_malloc(M*L*sizeof(float) , 32));
-    auto B = static_cast<float*>(_mm_malloc(N*L*sizeof(float) , 32));
-    auto C = static_cast<float*>(_mm_malloc(M*N*sizeof(float) , 32));
+    aligned_buffer_t<float, 32> A(M*L);
+    aligned_buffer_t<float, 32> B(N*L);
+    aligned_buffer_t<float, 32> C(M*N);
     TIMERSTOP(alloc_memory)
 
     TIMERSTART(init)
-    init(A, M*L);
-    init(B, N*L);
+    init(A.data(), M*L);
+    init(B.data(), N*L);
     TIMERSTOP(init)
 
     TIMERSTART(plain_dmm_single)
-    plain_dmm(A, B, C, M, L, N, false);
+    plain_dmm(A.data(), B.data(), C.data(), M, L, N, false);
     TIMERSTOP(plain_dmm_single)
 
     TIMERSTART(plain_dmm_multi)
-    plain_dmm(A, B, C, M, L, N, true);
+    plain_dmm(A.data(), B.data(), C.data(), M, L, N, true);
     TIMERSTOP(plain_dmm_multi)
 
     TIMERSTART(avx_dmm_single)
-    avx_dmm(A, B, C, M, L, N, false);
+    avx_dmm(A.data(), B.data(), C.data(), M, L, N, false);
     TIMERSTOP(avx_dmm_single)
 
     TIMERSTART(avx_dmm_multi)
-    avx_dmm(A, B, C, M, L, N, true);
+    avx_dmm(A.data(), B.data(), C.data(), M, L, N, true);
     TIMERSTOP(avx_dmm_multi)
 
     TIMERSTART(avx_dmm_unroll_2_single)
-    avx_dmm_unroll_2(A, B, C, M, L, N, false);
+    avx_dmm_unroll_2(A.data(), B.data(), C.data(), M, L, N, false);
     TIMERSTOP(avx_dmm_unroll_2_single)
 
     TIMERSTART(avx_dmm_unroll_2_multi)
-    avx_dmm_unroll_2(A, B, C, M, L, N, true);
+    avx_dmm_unroll_2(A.data(), B.data(), C.data(), M, L, N, true);
     TIMERSTOP(avx_dmm_unroll_2_multi)
 
     TIMERSTART(free_memory)
-    _mm_free(A);
-    _mm_free(B);
-    _mm_free(C);
+    A.release();
+    B.release();
+    C.release();
     TIMERSTOP(free_memory)
 }
@@ -5,6 +5,8 @@
 
 // timers distributed with this book
 #include "../include/hpc_helpers.hpp"
+// aligned, huge page backed and NUMA placed memory
+#include "../include/aligned_buffer.hpp"
 
 void init(float * data, uint64_t length) {
 
@@ -39,30 +41,29 @@ void avx_pointwise_max(float * x,
 int main () {
 
     const uint64_t num_entries = 1UL << 28;
-    const uint64_t num_bytes = num_entries*sizeof(float);
 
     TIMERSTART(alloc_memory)
-    auto x = static_cast<float*>(_mm_malloc(num_bytes , 32));
-    auto y = static_cast<float*>(_mm_malloc(num_bytes , 32));
-    auto z = static_cast<float*>(_mm_malloc(num_bytes , 32));
+    aligned_buffer_t<float, 32> x(num_entries);
+    aligned_buffer_t<float, 32> y(num_entries);
+    aligned_buffer_t<float, 32> z(num_entries);
     TIMERSTOP(alloc_memory)
 
     TIMERSTART(init)
-    init(x, num_entries);
-    init(y, num_entries);
+    init(x.data(), num_entries);
+    init(y.data(), num_entries);
     TIMERSTOP(init)
 
     TIMERSTART(plain_pointwise_max)
-    plain_pointwise_max(x, y, z, num_entries);
+    plain_pointwise_max(x.data(), y.data(), z.data(), num_entries);
     TIMERSTOP(plain_pointwise_max)
 
     TIMERSTART(avx_pointwise_max)
-    avx_pointwise_max(x, y, z, num_entries);
+    avx_pointwise_max(x.data(), y.data(), z.data(), num_entries);
     TIMERSTOP(avx_pointwise_max)
 
     TIMERSTART(free_memory)
-    _mm_free(x);
-    _mm_free(y);
-    _mm_free(z);
+    x.release();
+    y.release();
+    z.release();
     TIMERSTOP(free_memory)
 }
@@ -5,6 +5,8 @@
 
 // timers distributed with this book
 #include "../include/hpc_helpers.hpp"
+// aligned, huge page backed and NUMA placed memory
+#include "../include/aligned_buffer.hpp"
 
 void init(float * data, uint64_t length) {
 
@@ -141,41 +143,40 @@ float plain_max_unroll_8(float * data, uint64_t length) {
 int main () {
 
     const uint64_t num_entries = 1UL << 28;
-    const uint64_t num_bytes = num_entries*sizeof(float);
 
     TIMERSTART(alloc_memory)
-    auto data = static_cast<float*>(_mm_malloc(num_bytes , 32));
+    aligned_buffer_t<float, 32> data(num_entries);
     TIMERSTOP(alloc_memory)
 
     TIMERSTART(init)
-    init(data, num_entries);
+    init(data.data(), num_entries);
     TIMERSTOP(init)
 
     TIMERSTART(plain_max)
-    std::cout << plain_max(data, num_entries) << std::endl;
+    std::cout << plain_max(data.data(), num_entries) << std::endl;
     TIMERSTOP(plain_max)
 
     TIMERSTART(plain_max_unroll_2)
-    std::cout << plain_max_unroll_2(data, num_entries) << std::endl;
+    std::cout << plain_max_unroll_2(data.data(), num_entries) << std::endl;
     TIMERSTOP(plain_max_unroll_2)
 
     TIMERSTART(plain_max_unroll_4)
-    std::cout << plain_max_unroll_4(data, num_entries) << std::endl;
+    std::cout << plain_max_unroll_4(data.data(), num_entries) << std::endl;
     TIMERSTOP(plain_max_unroll_4)
 
     TIMERSTART(plain_max_unroll_8)
-    std::cout << plain_max_unroll_8(data, num_entries) << std::endl;
+    std::cout << plain_max_unroll_8(data.data(), num_entries) << std::endl;
     TIMERSTOP(plain_max_unroll_8)
 
     TIMERSTART(avx_max)
-    std::cout << avx_max(data, num_entries) << std::endl;
+    std::cout << avx_max(data.data(), num_entries) << std::endl;
     TIMERSTOP(avx_max)
 
     TIMERSTART(avx_max_unroll_2)
-    std::cout << avx_max_unroll_2(data, num_entries) << std::endl;
+    std::cout << avx_max_unroll_2(data.data(), num_entries) << std::endl;
     TIMERSTOP(avx_max_unroll_2)
 
     TIMERSTART(free_memory)
-    _mm_free(data);
+    data.release();
     TIMERSTOP(free_memory)
 }
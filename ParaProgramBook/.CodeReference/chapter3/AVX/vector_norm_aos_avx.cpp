@@ -5,6 +5,8 @@
 
 // timers distributed with this book
 #include "../include/hpc_helpers.hpp"
+// aligned, huge page backed and NUMA placed memory
+#include "../include/aligned_buffer.hpp"
 
 void aos_init(float * xyz, uint64_t length) {
 
@@ -102,25 +104,24 @@ void aos_check(float * xyz, uint64_t length) {
 int main () {
 
     const uint64_t num_vectors = 1UL << 28;
-    const uint64_t num_bytes = 3*num_vectors*sizeof(float);
 
     TIMERSTART(alloc_memory)
-    auto xyz = static_cast<float*>(_mm_malloc(num_bytes , 32));
+    aligned_buffer_t<float, 32> xyz(3*num_vectors);
     TIMERSTOP(alloc_memory)
 
     TIMERSTART(init)
-    aos_init(xyz, num_vectors);
+    aos_init(xyz.data(), num_vectors);
     TIMERSTOP(init)
 
     TIMERSTART(avx_aos_normalize)
-    avx_aos_norm(xyz, num_vectors);
+    avx_aos_norm(xyz.data(), num_vectors);
     TIMERSTOP(avx_aos_normalize)
 
     TIMERSTART(check)
-    aos_check(xyz, num_vectors);
+    aos_check(xyz.data(), num_vectors);
     TIMERSTOP(check)
 
     TIMERSTART(free_memory)
-    _mm_free(xyz);
+    xyz.release();
     TIMERSTOP(free_memory)
 }
@@ -5,6 +5,8 @@
 
 // timers distributed with this book
 #include "../include/hpc_helpers.hpp"
+// aligned, huge page backed and NUMA placed memory
+#include "../include/aligned_buffer.hpp"
 
 void soa_init(float * x,
               float * y,
@@ -64,29 +66,28 @@ void soa_check(float * x,
 int main () {
 
     const uint64_t num_vectors = 1UL << 28;
-    const uint64_t num_bytes = num_vectors*sizeof(float);
 
     TIMERSTART(alloc_memory)
-    auto x = static_cast<float*>(_mm_malloc(num_bytes , 32));
-    auto y = static_cast<float*>(_mm_malloc(num_bytes , 32));
-    auto z = static_cast<float*>(_mm_malloc(num_bytes , 32));
+    aligned_buffer_t<float, 32> x(num_vectors);
+    aligned_buffer_t<float, 32> y(num_vectors);
+    aligned_buffer_t<float, 32> z(num_vectors);
     TIMERSTOP(alloc_memory)
 
     TIMERSTART(init)
-    soa_init(x, y, z, num_vectors);
+    soa_init(x.data(), y.data(), z.data(), num_vectors);
     TIMERSTOP(init)
 
     TIMERSTART(avx_soa_normalize)
-    avx_soa_norm(x, y, z, num_vectors);
+    avx_soa_norm(x.data(), y.data(), z.data(), num_vectors);
     TIMERSTOP(avx_soa_normalize)
 
     TIMERSTART(check)
-    soa_check(x, y, z, num_vectors);
+    soa_check(x.data(), y.data(), z.data(), num_vectors);
     TIMERSTOP(check)
 
     TIMERSTART(free_memory)
-    _mm_free(x);
-    _mm_free(y);
-    _mm_free(z);
+    x.release();
+    y.release();
+    z.release();
     TIMERSTOP(free_memory)
 }
@@ -4,13 +4,15 @@
 #include <thread>                     // std::thread (not used yet)
 #include "../include/hpc_helpers.hpp" // timers, no_init_t
 #include "../include/binary_IO.hpp"   // load_binary
+#include "../include/aligned_buffer.hpp" // aligned_buffer_t
+#include "../include/cpu_topology.hpp"   // pin_this_thread
 
 template <
     typename index_t,
     typename value_t>
 void sequential_all_pairs(
-    std::vector<value_t>& mnist,
-    std::vector<value_t>& all_pair,
+    aligned_buffer_t<value_t>& mnist,
+    aligned_buffer_t<value_t>& all_pair,
     index_t rows,
     index_t cols) {
 
@@ -36,14 +38,18 @@ template <
     typename index_t,
     typename value_t>
 void parallel_all_pairs(
-    std::vector<value_t>& mnist,
-    std::vector<value_t>& all_pair,
+    aligned_buffer_t<value_t>& mnist,
+    aligned_buffer_t<value_t>& all_pair,
     index_t rows,
     index_t cols,
     index_t num_threads=64,
     index_t chunk_size=64/sizeof(value_t)) {
 
+    const auto placed = cpu_topology().placement(pin_policy_from_env(), num_threads);
+
     auto block_cyclic = [&] (const index_t& id) -> void {
+        if (id < placed.size())
+            pin_this_thread(placed[id]);
 
         // precompute offset and stride
         const index_t off = id*chunk_size;
@@ -85,6 +91,43 @@ void parallel_all_pairs(
         thread.join();
 }
 
+template <
+    typename index_t,
+    typename value_t>
+void first_touch_block_cyclic(
+    aligned_buffer_t<value_t>& all_pair,
+    index_t rows,
+    index_t num_threads=64,
+    index_t chunk_size=64/sizeof(value_t)) {
+
+    const auto placed = cpu_topology().placement(pin_policy_from_env(), num_threads);
+
+    // zero the rows each thread of parallel_all_pairs will compute,
+    // using the same pinning and the same block-cyclic partition
+    auto touch = [&] (const index_t& id) -> void {
+        if (id < placed.size())
+            pin_this_thread(placed[id]);
+
+        const index_t off = id*chunk_size;
+        const index_t str = num_threads*chunk_size;
+
+        for (index_t lower = off; lower < rows; lower += str) {
+            const index_t upper = std::min(lower+chunk_size,rows);
+            for (index_t i = lower; i < upper; i++)
+                for (index_t I = 0; I < rows; I++)
+                    all_pair[i*rows+I] = value_t(0);
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (index_t id = 0; id < num_threads; id++)
+        threads.emplace_back(touch, id);
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
 #include <mutex>
 #include <atomic>
 
@@ -94,8 +137,8 @@ template <
     typename index_t,
     typename value_t>
 void dynamic_all_pairs(
-    std::vector<value_t>& mnist,
-    std::vector<value_t>& all_pair,
+    aligned_buffer_t<value_t>& mnist,
+    aligned_buffer_t<value_t>& all_pair,
     index_t rows,
     index_t cols,
     index_t num_threads=64,
@@ -104,7 +147,11 @@ void dynamic_all_pairs(
     // declare mutex and current lower index
     index_t global_lower = 0;
 
+    const auto placed = cpu_topology().placement(pin_policy_from_env(), num_threads);
+
     auto dynamic_block_cyclic = [&] (const index_t& id ) -> void {
+        if (id < placed.size())
+            pin_this_thread(placed[id]);
 
         // assume we have not done anything
         index_t lower = 0;
@@ -157,8 +204,8 @@ template <
     typename index_t,
     typename value_t>
 void dynamic_all_pairs_rev(
-    std::vector<value_t>& mnist,
-    std::vector<value_t>& all_pair,
+    aligned_buffer_t<value_t>& mnist,
+    aligned_buffer_t<value_t>& all_pair,
     index_t rows,
     index_t cols,
     index_t num_threads=64,
@@ -167,7 +214,11 @@ void dynamic_all_pairs_rev(
     // declare mutex and current lower index
     index_t global_lower = 0;
 
+    const auto placed = cpu_topology().placement(pin_policy_from_env(), num_threads);
+
     auto dynamic_block_cyclic = [&] (const index_t& id ) -> void {
+        if (id < placed.size())
+            pin_this_thread(placed[id]);
 
         // assume we have not done anything
         index_t lower = 0;
@@ -218,28 +269,47 @@ void dynamic_all_pairs_rev(
 
 int main() {
 
-    // used data types
-    typedef no_init_t<float> value_t;
+    // used data types (aligned_buffer_t does not initialize)
+    typedef float            value_t;
     typedef uint64_t         index_t;
 
     // number of images and pixels
     const index_t rows = 65000;
     const index_t cols = 28*28;
+    const index_t num_threads = 64;
 
     // load MNIST data from binary file
     TIMERSTART(load_data_from_disk)
-    std::vector<value_t> mnist(rows*cols);
+    aligned_buffer_t<value_t> mnist(rows*cols);
     load_binary(mnist.data(), rows*cols,
                 "./data/mnist_65000_28_28_32.bin");
     TIMERSTOP(load_data_from_disk)
 
+    // the static kernel owns fixed blocks of rows, hence each thread
+    // first touches the rows it will compute; the dynamic kernel hands
+    // blocks to whichever thread is idle, so no thread owns a row and the
+    // pages of the 16 GB distance matrix are interleaved instead
+    const bool dynamic_schedule = true;
+
+    TIMERSTART(alloc_distances)
+    aligned_buffer_t<value_t> all_pair(rows*rows,
+                                       page_mode_t::transparent,
+                                       dynamic_schedule ?
+                                       touch_mode_t::interleave :
+                                       touch_mode_t::none);
+    if (!dynamic_schedule)
+        first_touch_block_cyclic(all_pair, rows, num_threads);
+    TIMERSTOP(alloc_distances)
+
     TIMERSTART(compute_distances)
-    std::vector<value_t> all_pair(rows*rows);
-    dynamic_all_pairs(mnist, all_pair, rows, cols);
+    if (dynamic_schedule)
+        dynamic_all_pairs(mnist, all_pair, rows, cols, num_threads);
+    else
+        parallel_all_pairs(mnist, all_pair, rows, cols, num_threads);
     TIMERSTOP(compute_distances)
 
 
     TIMERSTART(dump_to_disk)
-    dump_binary(mnist.data(), rows*rows, "./all_pairs.bin");
+    dump_binary(all_pair.data(), rows*rows, "./all_pairs.bin");
     TIMERSTOP(dump_to_disk)
 }
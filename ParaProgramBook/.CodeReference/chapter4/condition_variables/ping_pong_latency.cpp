@@ -0,0 +1,101 @@
+#include <iostream>            // std::cout
+#include <cstdint>             // uint64_t
+#include <cstdlib>             // atol
+#include <thread>              // std::thread
+#include <mutex>               // std::mutex
+#include <chrono>              // std::chrono::steady_clock
+#include <condition_variable>  // std::condition_variable
+
+// semaphore_t and handoff_channel_t spin briefly, then park on a futex
+#include "../include/futex_event.hpp"
+
+// mean round trip time in microseconds of num_rounds ping pongs
+template <
+    typename ping_t,
+    typename pong_t>
+double round_trip(
+    ping_t ping,
+    pong_t pong,
+    uint64_t num_rounds) {
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread ping_thread(ping, num_rounds);
+    std::thread pong_thread(pong, num_rounds);
+    ping_thread.join();
+    pong_thread.join();
+    auto stop = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::micro> delta = stop-start;
+    return delta.count()/num_rounds;
+}
+
+int main(int argc, char * argv[]) {
+
+    const uint64_t num_rounds = argc > 1 ? atol(argv[1]) : 100000;
+
+    // the pattern of ping_pong.cpp without the 1s sleeps
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool is_ping = true;
+
+    auto cv_ping = [&] (uint64_t rounds) -> void {
+        for (uint64_t round = 0; round < rounds; round++) {
+            std::unique_lock<std::mutex> unique_lock(mutex);
+            cv.wait(unique_lock,[&](){return is_ping;});
+            is_ping = !is_ping;
+            cv.notify_one();
+        }
+    };
+
+    auto cv_pong = [&] (uint64_t rounds) -> void {
+        for (uint64_t round = 0; round < rounds; round++) {
+            std::unique_lock<std::mutex> unique_lock(mutex);
+            cv.wait(unique_lock,[&](){return !is_ping;});
+            is_ping = !is_ping;
+            cv.notify_one();
+        }
+    };
+
+    // one semaphore per direction
+    semaphore_t ping_turn(1), pong_turn(0);
+
+    auto sem_ping = [&] (uint64_t rounds) -> void {
+        for (uint64_t round = 0; round < rounds; round++) {
+            ping_turn.wait();
+            pong_turn.post();
+        }
+    };
+
+    auto sem_pong = [&] (uint64_t rounds) -> void {
+        for (uint64_t round = 0; round < rounds; round++) {
+            pong_turn.wait();
+            ping_turn.post();
+        }
+    };
+
+    // the ball is a value sent back and forth over two channels
+    handoff_channel_t<uint64_t> to_pong, to_ping;
+
+    auto chan_ping = [&] (uint64_t rounds) -> void {
+        uint64_t ball = 0;
+        for (uint64_t round = 0; round < rounds; round++) {
+            to_pong.send(ball);
+            ball = to_ping.receive()+1;
+        }
+    };
+
+    auto chan_pong = [&] (uint64_t rounds) -> void {
+        for (uint64_t round = 0; round < rounds; round++)
+            to_ping.send(to_pong.receive());
+    };
+
+    std::cout << "# mean round trip in microseconds ("
+              << num_rounds << " rounds, spin limit "
+              << default_spin_limit() << ")" << std::endl;
+    std::cout << "condition_variable\t"
+              << round_trip(cv_ping, cv_pong, num_rounds) << std::endl;
+    std::cout << "futex semaphore   \t"
+              << round_trip(sem_ping, sem_pong, num_rounds) << std::endl;
+    std::cout << "handoff channel   \t"
+              << round_trip(chan_ping, chan_pong, num_rounds) << std::endl;
+}
@@ -0,0 +1,123 @@
+#include <iostream>            // std::cout
+#include <iomanip>             // std::setw
+#include <cstdint>             // uint64_t
+#include <cstdlib>             // atol
+#include <vector>              // std::vector
+#include <random>              // std::mt19937
+#include <atomic>              // std::atomic
+#include <thread>              // std::thread
+#include <chrono>              // std::chrono::steady_clock
+#include <algorithm>           // std::sort
+
+#include "../thread_pool/threadpool_basic.hpp" // ThreadPool
+#include "../include/timer_wheel.hpp"          // timer_wheel_t
+#include "../include/futex_event.hpp"          // event_t
+
+typedef std::chrono::steady_clock clock_type;
+
+// lateness of the alarms in microseconds, never negative
+void print_jitter(const char * label, std::vector<double> lateness) {
+    std::sort(lateness.begin(), lateness.end());
+    auto at = [&] (double q) { return lateness[q*(lateness.size()-1)]; };
+    std::cout << std::left << std::setw(22) << label << std::right
+              << std::fixed << std::setprecision(1)
+              << std::setw(10) << at(0.5)
+              << std::setw(10) << at(0.9)
+              << std::setw(10) << at(0.99)
+              << std::setw(12) << at(1.0) << std::endl;
+}
+
+int main(int argc, char * argv[]) {
+
+    const uint64_t num_timers  = argc > 1 ? atol(argv[1]) : 200000;
+    const uint64_t num_threads = argc > 2 ? atol(argv[2]) : 4;
+    const uint64_t max_delay   = 2000;  // milliseconds
+    const uint64_t cancel_every = 10;   // cancel every 10th timer
+
+    // the pool must outlive the wheel that dispatches to it
+    ThreadPool TP(num_threads);
+    timer_wheel_t wheel(TP);
+
+    std::vector<clock_type::time_point> deadlines(num_timers);
+    std::vector<double> lateness(num_timers, 0);
+    std::vector<timer_id_t> ids(num_timers);
+    std::vector<uint8_t> cancelled(num_timers, 0);
+
+    // one count per timer plus one held by main until all cancels are
+    // done, whoever drops it to zero signals the event
+    std::atomic<uint64_t> remaining(num_timers+1);
+    event_t all_fired;
+
+    std::mt19937 engine(42);
+    std::uniform_int_distribution<uint64_t> delay(1, max_delay);
+
+    // one callback per timer, it records how late it ran
+    auto alarm = [&] (uint64_t timer) {
+        return [&, timer] () {
+            std::chrono::duration<double, std::micro> late =
+                clock_type::now()-deadlines[timer];
+            lateness[timer] = late.count();
+            if (remaining.fetch_sub(1) == 1)
+                all_fired.set();
+        };
+    };
+
+    auto start = clock_type::now();
+    for (uint64_t timer = 0; timer < num_timers; timer++) {
+        deadlines[timer] = clock_type::now()+
+                           std::chrono::milliseconds(delay(engine));
+        ids[timer] = wheel.schedule_at(deadlines[timer], alarm(timer));
+    }
+    std::chrono::duration<double> insert_time = clock_type::now()-start;
+
+    start = clock_type::now();
+    uint64_t num_cancelled = 0;
+    for (uint64_t timer = 0; timer < num_timers; timer += cancel_every)
+        num_cancelled += cancelled[timer] = wheel.cancel(ids[timer]);
+    std::chrono::duration<double> cancel_time = clock_type::now()-start;
+
+    // a timer that fired before its cancel was counted by its alarm
+    if (remaining.fetch_sub(num_cancelled+1) == num_cancelled+1)
+        all_fired.set();
+    all_fired.wait();
+    std::chrono::duration<double> total_time = clock_type::now()-start;
+
+    std::vector<double> fired;
+    for (uint64_t timer = 0; timer < num_timers; timer++)
+        if (!cancelled[timer])
+            fired.push_back(lateness[timer]);
+
+    std::cout << "# " << num_timers << " timers within " << max_delay
+              << " ms, " << num_cancelled << " cancelled, " << num_threads
+              << " pool threads" << std::endl;
+    std::cout << "insert\t" << std::fixed << std::setprecision(0)
+              << num_timers/insert_time.count() << " timers/sec"
+              << std::endl;
+    std::cout << "cancel\t" << (num_timers/cancel_every)/cancel_time.count()
+              << " timers/sec" << std::endl;
+    std::cout << "fire\t" << fired.size()/total_time.count()
+              << " timers/sec (mean over " << total_time.count()
+              << " s)" << std::endl;
+
+    std::cout << "# lateness in us             p50       p90       p99"
+              << "         max" << std::endl;
+    print_jitter("timer wheel + pool", fired);
+
+    // baseline: one thread per alarm as in alarm_clock.cpp
+    const uint64_t num_sleepers = std::min<uint64_t>(num_timers, 1000);
+    std::vector<double> sleeper_lateness(num_sleepers);
+    std::vector<std::thread> threads;
+    for (uint64_t timer = 0; timer < num_sleepers; timer++) {
+        auto deadline = clock_type::now()+
+                        std::chrono::milliseconds(delay(engine));
+        threads.emplace_back([&, timer, deadline] () {
+            std::this_thread::sleep_until(deadline);
+            std::chrono::duration<double, std::micro> late =
+                clock_type::now()-deadline;
+            sleeper_lateness[timer] = late.count();
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    print_jitter("thread per alarm", sleeper_lateness);
+}
@@ -1,4 +1,7 @@
 #include "../include/hpc_helpers.hpp"
+// cache_aligned_t and the FALSE_SHARING_* instrumentation macros
+// (compile with -DFALSE_SHARING_CHECK to sample the written lines)
+#include "../include/cache_aligned.hpp"
 
 #include <thread>
 
@@ -9,6 +12,14 @@ struct pack_t {
     pack_t() : ying(0), yang(0) {}
 };
 
+// the same with one cache line per member
+struct padded_pack_t {
+    cache_aligned_t<uint64_t> ying;
+    cache_aligned_t<uint64_t> yang;
+
+    padded_pack_t() : ying(0), yang(0) {}
+};
+
 void sequential_increment(
     volatile pack_t& pack) {
 
@@ -23,13 +34,40 @@ void false_sharing_increment(
     volatile pack_t& pack) {
 
     auto eval_ying = [&pack] () -> void {
-        for (uint64_t index = 0; index < 1UL << 30; index++)
+        for (uint64_t index = 0; index < 1UL << 30; index++) {
+            FALSE_SHARING_WRITE(&pack.ying);
             pack.ying++;
+        }
     };
 
     auto eval_yang = [&pack] () -> void {
-        for (uint64_t index = 0; index < 1UL << 30; index++)
+        for (uint64_t index = 0; index < 1UL << 30; index++) {
+            FALSE_SHARING_WRITE(&pack.yang);
             pack.yang++;
+        }
+    };
+
+    std::thread ying_thread(eval_ying);
+    std::thread yang_thread(eval_yang);
+    ying_thread.join();
+    yang_thread.join();
+}
+
+void padded_increment(
+    volatile padded_pack_t& pack) {
+
+    auto eval_ying = [&pack] () -> void {
+        for (uint64_t index = 0; index < 1UL << 30; index++) {
+            FALSE_SHARING_WRITE(&pack.ying.value);
+            pack.ying.value++;
+        }
+    };
+
+    auto eval_yang = [&pack] () -> void {
+        for (uint64_t index = 0; index < 1UL << 30; index++) {
+            FALSE_SHARING_WRITE(&pack.yang.value);
+            pack.yang.value++;
+        }
     };
 
     std::thread ying_thread(eval_ying);
@@ -55,4 +93,16 @@ int main(int argc, char* argv[]) {
     TIMERSTOP(false_sharing_increment_increment)
 
     std::cout << par_pack.ying << " " << par_pack.yang << std::endl;
+
+    padded_pack_t pad_pack;
+
+    TIMERSTART(padded_increment)
+    padded_increment(pad_pack);
+    TIMERSTOP(padded_increment)
+
+    std::cout << pad_pack.ying.value << " "
+              << pad_pack.yang.value << std::endl;
+
+    // in test mode: the line of par_pack is reported, pad_pack is not
+    FALSE_SHARING_REPORT();
 }
@@ -1,4 +1,5 @@
 #include "../include/hpc_helpers.hpp"
+#include "../include/cpu_topology.hpp"
 
 #include <iostream>
 #include <cstdint>
@@ -51,8 +52,12 @@ void cyclic_parallel_mult(
     index_t n,               // number of cols
     index_t num_threads=8) { // number of threads p
 
+    const auto placed = cpu_topology().placement(pin_policy_from_env(), num_threads);
+
     // this  function  is  called  by the  threads
     auto cyclic = [&] (const index_t& id) -> void {
+        if (id < placed.size())
+            pin_this_thread(placed[id]);
 
         // indices are incremented with a stride of p
         for (index_t row = id; row < m; row += num_threads) {
@@ -84,9 +89,13 @@ void block_parallel_mult(
     index_t n,
     index_t num_threads=32) {
 
+    const auto placed = cpu_topology().placement(pin_policy_from_env(), num_threads);
+
     // this function is called by the threads
     auto block = [&] (const index_t& id) -> void {
         //        ^-- capture whole scope by reference
+        if (id < placed.size())
+            pin_this_thread(placed[id]);
 
         // compute chunk size, lower and upper task id
         const index_t chunk = SDIV(m, num_threads);
@@ -126,8 +135,12 @@ void block_cyclic_parallel_mult(
     index_t chunk_size=64/sizeof(value_t)) {
 
 
+    const auto placed = cpu_topology().placement(pin_policy_from_env(), num_threads);
+
     // this  function  is  called  by the  threads
     auto block_cyclic = [&] (const index_t& id) -> void {
+        if (id < placed.size())
+            pin_this_thread(placed[id]);
 
         // precomupute the stride
 	const index_t stride = num_threads*chunk_size;
@@ -0,0 +1,166 @@
+#include "../include/hpc_helpers.hpp"
+#include "../include/thread_team.hpp"
+#include "../include/cpu_topology.hpp"
+
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+// the rows lower..upper of b = A*x
+template <
+    typename value_t,
+    typename index_t>
+void mult_rows(
+    const std::vector<value_t>& A,
+    const std::vector<value_t>& x,
+    std::vector<value_t>& b,
+    index_t n,
+    index_t lower,
+    index_t upper) {
+
+    for (index_t row = lower; row < upper; row++) {
+        value_t accum = value_t(0);
+        for (index_t col = 0; col < n; col++)
+            accum += A[row*n+col]*x[col];
+        b[row] = accum;
+    }
+}
+
+// block_cyclic_parallel_mult: fresh threads on every call
+template <
+    typename value_t,
+    typename index_t>
+void block_cyclic_parallel_mult(
+    const std::vector<value_t>& A,
+    const std::vector<value_t>& x,
+    std::vector<value_t>& b,
+    index_t m,
+    index_t n,
+    index_t num_threads,
+    index_t chunk_size=64/sizeof(value_t)) {
+
+    const auto placed = cpu_topology().placement(pin_policy_from_env(), num_threads);
+
+    auto block_cyclic = [&] (const index_t& id) -> void {
+        if (id < placed.size())
+            pin_this_thread(placed[id]);
+        const index_t stride = num_threads*chunk_size;
+        for (index_t lower = id*chunk_size; lower < m; lower += stride)
+            mult_rows(A, x, b, n, lower, std::min(lower+chunk_size, m));
+    };
+
+    std::vector<std::thread> threads;
+
+    for (index_t id = 0; id < num_threads; id++)
+        threads.emplace_back(block_cyclic, id);
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// the same kernel as one phase of a persistent team
+template <
+    typename value_t,
+    typename index_t>
+void block_cyclic_team_mult(
+    thread_team_t& team,
+    const std::vector<value_t>& A,
+    const std::vector<value_t>& x,
+    std::vector<value_t>& b,
+    index_t m,
+    index_t n,
+    index_t chunk_size=64/sizeof(value_t)) {
+
+    const index_t stride = team.size()*chunk_size;
+    team.run([&] (uint64_t id) -> void {
+        for (index_t lower = id*chunk_size; lower < m; lower += stride)
+            mult_rows(A, x, b, n, lower, std::min(lower+chunk_size, m));
+    });
+}
+
+double micro_seconds_since(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double, std::micro> delta =
+        std::chrono::steady_clock::now()-start;
+    return delta.count();
+}
+
+int main(int argc, char* argv[]) {
+
+    const uint64_t num_threads = argc > 1 ? atol(argv[1]) : 8;
+    const uint64_t num_iters   = argc > 2 ? atol(argv[2]) : 1000;
+    const uint64_t n = 1UL << 9;
+    const uint64_t m = 1UL << 9;
+
+    std::vector<uint64_t> A(m*n), x(n), b(m);
+    for (uint64_t row = 0; row < m; row++)
+        for (uint64_t col = 0; col < n; col++)
+            A[row*n+col] = row >= col ? 1 : 0;
+    for (uint64_t col = 0; col < n; col++)
+        x[col] = col;
+
+    auto check = [&] () -> void {
+        for (uint64_t index = 0; index < m; index++)
+            if (b[index] != index*(index+1)/2)
+                std::cout << "error at position " << index << " "
+                          << b[index] << std::endl;
+    };
+
+    thread_team_t team(num_threads);
+
+    std::cout << "# " << num_iters << " products of a " << m << "x" << n
+              << " matrix on " << num_threads << " threads" << std::endl;
+
+    TIMERSTART(fresh_threads)
+    for (uint64_t iter = 0; iter < num_iters; iter++)
+        block_cyclic_parallel_mult(A, x, b, m, n, num_threads);
+    TIMERSTOP(fresh_threads)
+    check();
+
+    TIMERSTART(team_run_per_product)
+    for (uint64_t iter = 0; iter < num_iters; iter++)
+        block_cyclic_team_mult(team, A, x, b, m, n);
+    TIMERSTOP(team_run_per_product)
+    check();
+
+    // all products in one job, a barrier between the phases
+    const uint64_t chunk_size = 64/sizeof(uint64_t);
+    const uint64_t stride = num_threads*chunk_size;
+    TIMERSTART(team_phases)
+    team.run(num_iters, [&] (uint64_t id, uint64_t) -> void {
+        for (uint64_t lower = id*chunk_size; lower < m; lower += stride)
+            mult_rows(A, x, b, n, lower, std::min(lower+chunk_size, m));
+    });
+    TIMERSTOP(team_phases)
+    check();
+
+    // synchronization overhead with empty phases
+    const uint64_t num_empty = 10*num_iters;
+    auto nothing = [] (uint64_t) -> void {};
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t iter = 0; iter < num_iters; iter++) {
+        std::vector<std::thread> threads;
+        for (uint64_t id = 0; id < num_threads; id++)
+            threads.emplace_back(nothing, id);
+        for (auto& thread : threads)
+            thread.join();
+    }
+    const double spawn_join = micro_seconds_since(start)/num_iters;
+
+    start = std::chrono::steady_clock::now();
+    for (uint64_t iter = 0; iter < num_empty; iter++)
+        team.run(nothing);
+    const double run = micro_seconds_since(start)/num_empty;
+
+    start = std::chrono::steady_clock::now();
+    team.run(num_empty, [] (uint64_t, uint64_t) -> void {});
+    const double barrier = micro_seconds_since(start)/num_empty;
+
+    std::cout << "# microseconds per empty phase" << std::endl;
+    std::cout << "spawn and join threads\t" << spawn_join << std::endl;
+    std::cout << "team.run (2 barriers)\t"  << run << std::endl;
+    std::cout << "barrier latency\t\t"      << barrier << std::endl;
+}
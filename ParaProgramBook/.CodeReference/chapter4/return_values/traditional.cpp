@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <vector>
 #include <thread>
+#include "../include/cache_aligned.hpp" // padded_array_t
 
 template <
     typename value_t,
@@ -25,7 +26,7 @@ int main(int argc, char * argv[]) {
     const uint64_t num_threads = 32;
 
     std::vector<std::thread> threads;
-    std::vector<uint64_t> results(num_threads);
+    padded_array_t<uint64_t> results(num_threads);
 
     for (uint64_t id = 0; id < num_threads; id++) {
 
@@ -39,6 +40,6 @@ int main(int argc, char * argv[]) {
     for (auto& thread: threads)
         thread.join();
 
-    for (auto& result: results)
-        std::cout << result << std::endl;
+    for (uint64_t id = 0; id < num_threads; id++)
+        std::cout << results[id] << std::endl;
 }
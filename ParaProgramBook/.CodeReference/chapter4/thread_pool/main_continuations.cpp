@@ -0,0 +1,77 @@
+#include <iostream>
+#include <cstdint>
+#include <vector>
+#include <stdexcept>
+
+#include "threadpool_basic.hpp"          // ThreadPool
+#include "../include/task_future.hpp"    // async_on, then, when_all, when_any
+
+// two threads only: stages that block in get() would soon occupy
+// all workers, continuations never hold a thread while waiting
+ThreadPool TP(2);
+
+uint64_t fibo(uint64_t n) {
+
+    uint64_t a_0 = 0;
+    uint64_t a_1 = 1;
+
+    for (uint64_t index = 0; index < n; index++) {
+        const uint64_t tmp = a_0; a_0 = a_1; a_1 += tmp;
+    }
+
+    return a_0;
+}
+
+int main () {
+
+    const uint64_t num_nodes = 32;
+
+    // stage 1 -> stage 2 chains: fibo(id) and then its square
+    std::vector<task_future_t<uint64_t>> squares;
+    for (uint64_t id = 0; id < num_nodes; id++)
+        squares.emplace_back(
+            async_on(TP, fibo, id).then([] (uint64_t x) {
+                return x*x;
+            })
+        );
+
+    // stage 3: join all chains, sum of squares of fibo numbers
+    // equals fibo(n-1)*fibo(n)
+    auto sum = when_all(squares).then([] (const std::vector<uint64_t>& xs) {
+        uint64_t result = 0;
+        for (const auto& x : xs)
+            result += x;
+        return result;
+    });
+
+    // stage 4: a continuation without result
+    auto check = sum.then([] (uint64_t result) {
+        if (result != fibo(num_nodes-1)*fibo(num_nodes))
+            throw std::runtime_error("sum of squares is wrong");
+    });
+
+    // whichever fibo number is done first
+    std::vector<task_future_t<uint64_t>> racers;
+    for (uint64_t id = 60; id < 64; id++)
+        racers.emplace_back(async_on(TP, fibo, id));
+    auto first = when_any(racers).get();
+
+    // exceptions skip the remaining stages and show up in get()
+    auto broken = async_on(TP, [] () -> uint64_t {
+        throw std::runtime_error("stage failed");
+    }).then([] (uint64_t x) {
+        return x+1;
+    });
+
+    // only the main thread blocks
+    check.get();
+    std::cout << "sum of squares: " << sum.get() << std::endl;
+    std::cout << "first racer: fibo(" << 60+first.first << ") = "
+              << first.second << std::endl;
+
+    try {
+        broken.get();
+    } catch (const std::exception& error) {
+        std::cout << "propagated: " << error.what() << std::endl;
+    }
+}
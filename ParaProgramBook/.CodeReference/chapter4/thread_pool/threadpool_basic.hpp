@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <future>
+#include <functional>
 #include <vector>
 #include <queue>
 #include <thread>
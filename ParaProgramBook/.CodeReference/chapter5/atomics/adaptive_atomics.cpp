@@ -0,0 +1,130 @@
+#include <iostream>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "../include/hpc_helpers.hpp"
+#include "../include/atomic_rmw.hpp"
+
+// the tight compare and swap loop from arbitrary_atomics.cpp
+template <
+    typename atomc_t,
+    typename value_t,
+    typename funct_t,
+    typename predc_t>
+value_t binary_atomic(
+    atomc_t& atomic,
+    const value_t& operand,
+    funct_t function,
+    predc_t predicate) {
+
+    value_t expect = atomic.load();
+    value_t target;
+
+    do {
+        target = function(expect, operand);
+
+        if (!predicate(target))
+            return expect;
+
+    } while (!atomic.compare_exchange_weak(expect, target));
+
+    return expect;
+}
+
+int main(int argc, char * argv[]) {
+
+    std::vector<std::thread> threads;
+    const uint64_t num_threads = argc > 1 ? atoi(argv[1]) : 10;
+    const uint64_t num_iters = 100'000'000;
+
+    // the even maximum as in arbitrary_atomics.cpp
+    auto func = [] (const uint64_t& lhs,
+                    const uint64_t& rhs) {
+        return lhs > rhs ? lhs : rhs;
+    };
+
+    auto pred = [] (const uint64_t& val) {
+        return val % 2 == 0;
+    };
+
+    // the same as a single function for combining and sharding
+    auto even_max = [] (const uint64_t& lhs,
+                        const uint64_t& rhs) {
+        return rhs > lhs && rhs % 2 == 0 ? rhs : lhs;
+    };
+
+    auto run = [&] (auto& closure) -> void {
+        threads.clear();
+        for (uint64_t id = 0; id < num_threads; id++)
+            threads.emplace_back(closure, id);
+        for (auto& thread : threads)
+            thread.join();
+    };
+
+    std::cout << "running " << num_threads << " threads" << std::endl;
+
+    TIMERSTART(cas_loop)
+    std::atomic<uint64_t> cas_counter(0);
+    auto cas_loop = [&] (const uint64_t& id) -> void {
+        for (uint64_t i = id; i < num_iters; i += num_threads)
+            binary_atomic(cas_counter, i, func, pred);
+    };
+    run(cas_loop);
+    TIMERSTOP(cas_loop)
+
+    TIMERSTART(cas_backoff)
+    std::atomic<uint64_t> backoff_counter(0);
+    auto cas_backoff = [&] (const uint64_t& id) -> void {
+        for (uint64_t i = id; i < num_iters; i += num_threads)
+            binary_atomic_backoff(backoff_counter, i, func, pred);
+    };
+    run(cas_backoff);
+    TIMERSTOP(cas_backoff)
+
+    TIMERSTART(flat_combining)
+    std::atomic<uint64_t> combined_counter(0);
+    flat_combiner_t<uint64_t, decltype(even_max)>
+        combiner(combined_counter, even_max, num_threads);
+    auto combining = [&] (const uint64_t& id) -> void {
+        for (uint64_t i = id; i < num_iters; i += num_threads)
+            combiner.apply(i, id);
+    };
+    run(combining);
+    TIMERSTOP(flat_combining)
+
+    // max is commutative: no shared state until the merge
+    TIMERSTART(sharded)
+    sharded_accumulator_t<uint64_t, decltype(even_max)>
+        accumulator(even_max, 0, num_threads);
+    auto sharded = [&] (const uint64_t& id) -> void {
+        for (uint64_t i = id; i < num_iters; i += num_threads)
+            accumulator.accumulate(i, id);
+    };
+    run(sharded);
+    const uint64_t sharded_counter = accumulator.load();
+    TIMERSTOP(sharded)
+
+    TIMERSTART(adaptive)
+    adaptive_rmw_t<uint64_t, decltype(even_max)>
+        adaptive_counter(0, even_max, num_threads);
+    auto adaptive = [&] (const uint64_t& id) -> void {
+        for (uint64_t i = id; i < num_iters; i += num_threads)
+            adaptive_counter.apply(i, id);
+    };
+    run(adaptive);
+    TIMERSTOP(adaptive)
+
+    const char * names[] = {"direct", "backoff", "combining"};
+    for (uint64_t id = 0; id < num_threads; id++)
+        std::cout << "# thread " << id << " ended with "
+                  << names[uint32_t(adaptive_counter.strategy(id))]
+                  << " after " << adaptive_counter.switches(id)
+                  << " switches" << std::endl;
+
+    std::cout << cas_counter << " "
+              << backoff_counter << " "
+              << combined_counter << " "
+              << sharded_counter << " "
+              << adaptive_counter.load() << std::endl;
+}
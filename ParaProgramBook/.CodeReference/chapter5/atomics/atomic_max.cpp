@@ -4,6 +4,7 @@
 #include <thread>
 #include <atomic>
 #include "../include/hpc_helpers.hpp"
+#include "../include/best_so_far.hpp"
 
 int main( ) {
 
@@ -32,6 +33,27 @@ int main( ) {
         }
     };
 
+    // argmax: the maximum and the thread that found it in a single
+    // 128-bit state, the compare and swap is skipped for all values
+    // that cannot win after a relaxed read of the maximum
+    auto best_max =
+        [&] (atomic_best_t<uint64_t, uint64_t>* best,
+             const auto& id) -> void {
+
+        for (uint64_t i = id; i < num_iters; i += num_threads)
+            best->update(i, id);
+    };
+
+    // the same with a thread-local pre-filter in front
+    auto filtered_max =
+        [&] (atomic_best_t<uint64_t, uint64_t>* best,
+             const auto& id) -> void {
+
+        auto filter = best->local_filter();
+        for (uint64_t i = id; i < num_iters; i += num_threads)
+            filter.update(i, id);
+    };
+
     TIMERSTART(incorrect_max)
     std::atomic<uint64_t> false_counter(0);
     threads.clear();
@@ -50,6 +72,28 @@ int main( ) {
         thread.join();
     TIMERSTOP(correct_max)
 
+    TIMERSTART(best_argmax)
+    atomic_best_t<uint64_t, uint64_t> best(0, 0);
+    threads.clear();
+    for (uint64_t id = 0; id < num_threads; id++)
+        threads.emplace_back(best_max, &best, id);
+    for (auto& thread : threads)
+        thread.join();
+    TIMERSTOP(best_argmax)
+
+    TIMERSTART(filtered_argmax)
+    atomic_best_t<uint64_t, uint64_t> filtered(0, 0);
+    threads.clear();
+    for (uint64_t id = 0; id < num_threads; id++)
+        threads.emplace_back(filtered_max, &filtered, id);
+    for (auto& thread : threads)
+        thread.join();
+    TIMERSTOP(filtered_argmax)
+
     std::cout << false_counter << " "
-              << correct_counter << std::endl;
+              << correct_counter << " "
+              << best.load().key << " (thread "
+              << best.load().payload << ") "
+              << filtered.load().key << " (thread "
+              << filtered.load().payload << ")" << std::endl;
 }
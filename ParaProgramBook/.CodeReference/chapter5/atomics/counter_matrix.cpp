@@ -0,0 +1,101 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include "../include/hpc_helpers.hpp"
+#include "../include/atomic_rmw.hpp"
+#include "../include/sharded_counter.hpp"
+
+// increments per second when num_threads threads concurrently
+// increment a counter num_iters times in total
+template <
+    typename funct_t>
+double ops_per_sec(
+    funct_t increment,
+    uint64_t num_threads,
+    uint64_t num_iters) {
+
+    std::vector<std::thread> threads;
+
+    auto count = [&] (const uint64_t& id) -> void {
+        for (uint64_t i = id; i < num_iters; i += num_threads)
+            increment();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t id = 0; id < num_threads; id++)
+        threads.emplace_back(count, id);
+    for (auto& thread : threads)
+        thread.join();
+    auto stop = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> delta = stop-start;
+    return num_iters/delta.count();
+}
+
+int main(int argc, char * argv[]) {
+
+    const uint64_t num_iters = argc > 1 ? atol(argv[1]) : 1UL << 24;
+    const uint64_t max_threads = 64;
+    const char * names[] = {"mutex", "spinlock", "ticket",
+                            "fetch_add", "sharded"};
+
+    std::cout << "# million increments per second ("
+              << num_iters << " increments)" << std::endl;
+    std::cout << "threads";
+    for (const auto& name : names)
+        std::cout << "\t" << std::setw(9) << name;
+    std::cout << std::endl;
+
+    for (uint64_t num_threads = 1; num_threads <= max_threads;
+         num_threads *= 2) {
+
+        std::mutex mutex;
+        spinlock_t spinlock;
+        ticket_lock_t ticket_lock;
+        uint64_t mutex_counter = 0, spin_counter = 0, ticket_counter = 0;
+        alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> atomic_counter(0);
+        sharded_counter_t<uint64_t> sharded_counter;
+
+        double rates[5];
+
+        rates[0] = ops_per_sec([&] () {
+            std::lock_guard<std::mutex> lock_guard(mutex);
+            mutex_counter++;
+        }, num_threads, num_iters);
+
+        rates[1] = ops_per_sec([&] () {
+            std::lock_guard<spinlock_t> lock_guard(spinlock);
+            spin_counter++;
+        }, num_threads, num_iters);
+
+        rates[2] = ops_per_sec([&] () {
+            std::lock_guard<ticket_lock_t> lock_guard(ticket_lock);
+            ticket_counter++;
+        }, num_threads, num_iters);
+
+        rates[3] = ops_per_sec([&] () {
+            atomic_counter.fetch_add(1, std::memory_order_relaxed);
+        }, num_threads, num_iters);
+
+        rates[4] = ops_per_sec([&] () {
+            sharded_counter++;
+        }, num_threads, num_iters);
+
+        // all counters must agree after the threads are joined
+        if (mutex_counter != num_iters || spin_counter != num_iters ||
+            ticket_counter != num_iters || atomic_counter != num_iters ||
+            sharded_counter.read() != num_iters)
+            std::cout << "ERROR: lost increments" << std::endl;
+
+        std::cout << num_threads;
+        for (const auto& rate : rates)
+            std::cout << "\t" << std::setw(9) << std::fixed
+                      << std::setprecision(2) << rate*1E-6;
+        std::cout << std::endl;
+    }
+}
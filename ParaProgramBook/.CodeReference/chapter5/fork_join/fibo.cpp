@@ -0,0 +1,236 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+#include <future>
+#include <atomic>
+#include <algorithm>
+
+#include "../include/fork_join.hpp"  // fork_join_pool_t, task_group_t
+
+// the naive recursion is the work, its exponential call tree the tasks
+uint64_t fibo(uint64_t n) {
+    return n < 2 ? n : fibo(n-1)+fibo(n-2);
+}
+
+// number of tasks spawned for fibo(n) with the given cutoff
+uint64_t num_tasks(uint64_t n, uint64_t cutoff) {
+    std::vector<uint64_t> count(n+1, 0);
+    for (uint64_t k = cutoff; k <= n; k++)
+        count[k] = 1 + (k >= 1 ? count[k-1] : 0) + (k >= 2 ? count[k-2] : 0);
+    return n < 2 ? 0 : count[n];
+}
+
+// below the cutoff we recurse sequentially, above it fibo(n-1) is
+// spawned and fibo(n-2) is computed by the spawning thread
+uint64_t fibo_pool(fork_join_pool_t& pool, uint64_t n, uint64_t cutoff) {
+
+    if (n < 2 || n < cutoff)
+        return fibo(n);
+
+    uint64_t left = 0;
+    task_group_t group;
+    pool.spawn(group, [&pool, &left, n, cutoff] () {
+        left = fibo_pool(pool, n-1, cutoff);
+    });
+    const uint64_t right = fibo_pool(pool, n-2, cutoff);
+    pool.wait(group);
+
+    return left+right;
+}
+
+// the same with one std::async thread per spawn
+uint64_t fibo_async(uint64_t n, uint64_t cutoff) {
+
+    if (n < 2 || n < cutoff)
+        return fibo(n);
+
+    auto left = std::async(std::launch::async, fibo_async, n-1, cutoff);
+    const uint64_t right = fibo_async(n-2, cutoff);
+
+    return left.get()+right;
+}
+
+// memoization: the first task to finish fibo(k) publishes it, later
+// calls (and the sibling subtrees still queued) reuse the value
+uint64_t fibo_memo(
+    fork_join_pool_t& pool,
+    std::vector<std::atomic<uint64_t>>& memo,
+    uint64_t n,
+    uint64_t cutoff) {
+
+    const uint64_t unknown = ~0UL;
+    const uint64_t cached = memo[n].load(std::memory_order_relaxed);
+    if (cached != unknown)
+        return cached;
+
+    uint64_t result;
+    if (n < 2 || n < cutoff) {
+        result = fibo(n);
+    } else {
+        uint64_t left = 0;
+        task_group_t group;
+        pool.spawn(group, [&pool, &memo, &left, n, cutoff] () {
+            left = fibo_memo(pool, memo, n-1, cutoff);
+        });
+        const uint64_t right = fibo_memo(pool, memo, n-2, cutoff);
+        pool.wait(group);
+        result = left+right;
+    }
+
+    memo[n].store(result, std::memory_order_relaxed);
+    return result;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> delta =
+        std::chrono::steady_clock::now()-start;
+    return delta.count();
+}
+
+void print_row(
+    const char * mode,
+    uint64_t cutoff,
+    double seconds,
+    double sequential,
+    uint64_t tasks,
+    uint64_t stolen) {
+
+    std::cout << std::left << std::setw(16) << mode << std::right
+              << std::setw(8)  << cutoff
+              << std::setw(12) << std::fixed << std::setprecision(2)
+              << seconds*1E3
+              << std::setw(10) << sequential/seconds
+              << std::setw(12) << tasks
+              << std::setw(14) << std::setprecision(0) << tasks/seconds
+              << std::setw(10) << stolen << std::endl;
+}
+
+// spawn latency: time from spawn() until the task starts running,
+// the caller only polls so that it cannot run the task itself
+template <
+    typename spawn_t>
+double spawn_latency(spawn_t spawn, uint64_t num_rounds) {
+
+    std::vector<double> latencies;
+    for (uint64_t round = 0; round < num_rounds; round++) {
+        std::atomic<bool> started(false);
+        std::chrono::steady_clock::time_point begin, end;
+
+        begin = std::chrono::steady_clock::now();
+        spawn([&] () {
+            end = std::chrono::steady_clock::now();
+            started.store(true, std::memory_order_release);
+        });
+
+        backoff_t backoff;
+        while (!started.load(std::memory_order_acquire))
+            backoff();
+
+        std::chrono::duration<double, std::micro> delta = end-begin;
+        latencies.push_back(delta.count());
+    }
+
+    // median, the first rounds wake up sleeping cores
+    std::sort(latencies.begin(), latencies.end());
+    return latencies[latencies.size()/2];
+}
+
+int main(int argc, char * argv[]) {
+
+    const uint64_t n = argc > 1 ? atol(argv[1]) : 32;
+    const uint64_t num_threads = argc > 2 ? atol(argv[2]) :
+                                 std::thread::hardware_concurrency();
+    const uint64_t max_async = 1UL << 12;  // threads std::async may spawn
+    const std::vector<uint64_t> cutoffs = {2, 8, 14, 20, 26};
+
+    auto start = std::chrono::steady_clock::now();
+    const uint64_t expect = fibo(n);
+    const double sequential = seconds_since(start);
+
+    std::cout << "# fibo(" << n << ") = " << expect << " on "
+              << num_threads << " workers, sequential "
+              << sequential*1E3 << " ms" << std::endl;
+    std::cout << "# mode            cutoff   time (ms)   speedup"
+              << "       tasks     tasks/sec    stolen" << std::endl;
+
+    fork_join_pool_t stealing(num_threads, schedule_mode_t::work_stealing);
+    fork_join_pool_t central(num_threads, schedule_mode_t::central_queue);
+
+    auto check = [&] (uint64_t result) {
+        if (result != expect)
+            std::cout << "# ERROR: got " << result << std::endl;
+    };
+
+    for (const auto& cutoff : cutoffs) {
+
+        for (auto pool : {&stealing, &central}) {
+            pool->reset_statistics();
+            start = std::chrono::steady_clock::now();
+            check(fibo_pool(*pool, n, cutoff));
+            print_row(pool == &stealing ? "work_stealing" : "central_queue",
+                      cutoff, seconds_since(start), sequential,
+                      pool->spawned(), pool->stolen());
+        }
+
+        stealing.reset_statistics();
+        std::vector<std::atomic<uint64_t>> memo(n+1);
+        for (auto& entry : memo)
+            entry.store(~0UL);
+        start = std::chrono::steady_clock::now();
+        check(fibo_memo(stealing, memo, n, cutoff));
+        print_row("memo_stealing", cutoff, seconds_since(start), sequential,
+                  stealing.spawned(), stealing.stolen());
+
+        const uint64_t tasks = num_tasks(n, cutoff);
+        if (tasks > max_async) {
+            std::cout << std::left << std::setw(16) << "std::async"
+                      << std::right << std::setw(8) << cutoff
+                      << "   skipped (" << tasks << " threads)" << std::endl;
+            continue;
+        }
+        start = std::chrono::steady_clock::now();
+        check(fibo_async(n, cutoff));
+        print_row("std::async", cutoff, seconds_since(start), sequential,
+                  tasks, 0);
+    }
+
+    // raw scheduler overhead: empty tasks spawned from one thread
+    const uint64_t num_empty = 1UL << 20;
+    std::cout << "# " << num_empty << " empty tasks spawned by main"
+              << std::endl;
+    for (auto pool : {&stealing, &central}) {
+        task_group_t group;
+        start = std::chrono::steady_clock::now();
+        for (uint64_t task = 0; task < num_empty; task++)
+            pool->spawn(group, [] () {});
+        pool->wait(group);
+        std::cout << (pool == &stealing ? "work_stealing" : "central_queue")
+                  << "\t" << std::fixed << std::setprecision(0)
+                  << num_empty/seconds_since(start) << " tasks/sec"
+                  << std::endl;
+    }
+
+    const uint64_t num_rounds = 1000;
+    std::cout << "# median spawn latency in microseconds ("
+              << num_rounds << " rounds)" << std::endl;
+    std::cout << std::setprecision(2);
+    for (auto pool : {&stealing, &central}) {
+        task_group_t group;
+        auto spawn = [&] (std::function<void(void)> func) {
+            pool->spawn(group, func);
+        };
+        std::cout << (pool == &stealing ? "work_stealing" : "central_queue")
+                  << "\t" << spawn_latency(spawn, num_rounds) << std::endl;
+        pool->wait(group);
+    }
+
+    std::vector<std::future<void>> futures;
+    auto spawn = [&] (std::function<void(void)> func) {
+        futures.emplace_back(std::async(std::launch::async, func));
+    };
+    std::cout << "std::async\t" << spawn_latency(spawn, num_rounds)
+              << std::endl;
+}
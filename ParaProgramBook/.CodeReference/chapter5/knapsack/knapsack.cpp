@@ -3,7 +3,9 @@
 #include <vector>         // std::vector
 #include <atomic>         // std::atomic
 #include <random>         // std::uniform_int_distribution
+#include <functional>     // std::greater_equal
 #include "threadpool.hpp" // work sharing thread pool
+#include "../include/best_so_far.hpp" // lock-free best-so-far
 
 template <
     typename value_t_,
@@ -23,31 +25,18 @@ struct generic_tuple_t {
                              weight(weight_) {}
 };
 
-template <
-    typename bmask_t_,
-    typename value_t_>
-struct state_t {
-
-    bmask_t_ bmask=0;
-    value_t_ value=0;
-
-    // expose template parameters
-    typedef bmask_t_ bmask_t;
-    typedef value_t_ value_t;
-
-    // non-default constructors are not allowed
-    // when wrapped with std::atomic<state_t>
-};
-
 // shortcuts for convenience
 typedef uint64_t index_t;
-typedef uint32_t bmask_t;
+typedef uint64_t bmask_t;
 typedef uint32_t value_t;
 typedef uint32_t weight_t;
 typedef generic_tuple_t<value_t, weight_t> tuple_t;
 
-// the global state encoding the mask and value
-std::atomic<state_t<bmask_t, value_t>> global_state;
+// the global state encoding the value and the mask: a 128-bit
+// state updated with cmpxchg16b, i.e. up to 64 items (ties replace
+// the stored solution like the former 64-bit compare and swap did)
+atomic_best_t<value_t, bmask_t, std::greater_equal<value_t>>
+    global_state(0, 0);
 const value_t capacity (1500);
 const index_t num_items (32);
 std::vector<tuple_t> tuples;
@@ -92,23 +81,8 @@ void atomic_update(
     tuple_t tuple,
     bmask_t bmask) {
 
-    typedef typename tuple_t::value_t value_t;
-
-    auto g_state = global_state.load();
-    auto l_value = tuple.value;
-    state_t<bmask_t, value_t> target;
-
-    do {
-
-        // exit if solution is not optimal
-        if (g_state.value > l_value)
-            return;
-
-        // construct the desired target
-        target.value = l_value;
-        target.bmask = bmask;
-
-    } while (!global_state.compare_exchange_weak(g_state, target));
+    // exits after a relaxed read if solution is not optimal
+    global_state.update(tuple.value, bmask);
 }
 
 template <
@@ -155,13 +129,13 @@ void traverse(
 
     // calculate local Danzig upper bound
     // and compare with global upper bound
-    auto bsf = global_state.load().value;
+    auto bsf = global_state.key();
     if (dantzig_bound(height+1, tuple) < bsf)
        return;
 
     // if everything was fine generate new candidate
     if (height+1 < num_items) {
-        traverse(height+1, tuple, bmask+(1<<(height+1)));
+        traverse(height+1, tuple, bmask+(bmask_t(1)<<(height+1)));
         traverse(height+1, tuple, bmask);
     }
 }
@@ -182,9 +156,9 @@ int main () {
 
     // report the final solution
     auto g_state = global_state.load();
-    std::cout << "value " << g_state.value << std::endl;
+    std::cout << "value " << g_state.key << std::endl;
 
-    auto bmask = g_state.bmask;
+    auto bmask = g_state.payload;
     for (index_t i = 0; i < num_items; i++) {
         std::cout << bmask % 2 << " ";
         bmask >>= 1;
@@ -0,0 +1,161 @@
+#include <iostream>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../include/hpc_helpers.hpp"    // timers
+#include "../include/cbf_generator.hpp"  // generate_cbf_range
+#include "../include/lockfree_queue.hpp" // spsc_queue_t, mpmc_queue_t
+
+// a block of series travelling through the pipeline: the buffer
+// slot it lives in and the range of series it holds
+struct job_t {
+    uint64_t slot;
+    uint64_t lower;
+    uint64_t upper;
+};
+
+// marks the end of the stream
+const uint64_t no_slot = ~0UL;
+
+// z-normalize every series of a block (zero mean, unit variance)
+template <
+    typename index_t,
+    typename value_t>
+void znormalize(
+    value_t * block,
+    index_t num_series,
+    index_t num_features) {
+
+    for (index_t series = 0; series < num_series; series++) {
+        value_t * x = block+series*num_features;
+
+        value_t mean = 0;
+        for (index_t j = 0; j < num_features; j++)
+            mean += x[j];
+        mean /= num_features;
+
+        value_t var = 0;
+        for (index_t j = 0; j < num_features; j++)
+            var += (x[j]-mean)*(x[j]-mean);
+        const value_t inv = 1/std::sqrt(var/num_features + 1E-12);
+
+        for (index_t j = 0; j < num_features; j++)
+            x[j] = (x[j]-mean)*inv;
+    }
+}
+
+int main(int argc, char * argv[]) {
+
+    // load -> compute -> dump
+    const uint64_t num_entries  = 1UL << 18;
+    const uint64_t num_features = 128;
+    const uint64_t block_rows   = 1UL << 10;
+    const uint64_t num_slots    = 16;   // blocks in flight
+    const long     workers_arg  = argc > 1 ? atol(argv[1]) : 4;
+
+    // without a worker the loader would block forever on a full queue
+    if (workers_arg < 1) {
+        std::cout << "usage: " << argv[0] << " [num_workers >= 1]"
+                  << std::endl;
+        return 1;
+    }
+    const uint64_t num_workers  = workers_arg;
+
+    std::vector<std::vector<float>> blocks(num_slots,
+        std::vector<float>(block_rows*num_features));
+    std::vector<std::vector<uint8_t>> labels(num_slots,
+        std::vector<uint8_t>(block_rows));
+
+    // free slots go from the dumper back to the loader (SPSC), full
+    // blocks fan out to the workers and fan in to the dumper (MPMC)
+    spsc_queue_t<uint64_t> free_slots(num_slots);
+    mpmc_queue_t<job_t> loaded(num_slots);
+    mpmc_queue_t<job_t> computed(num_slots);
+
+    for (uint64_t slot = 0; slot < num_slots; slot++)
+        free_slots.push(slot);
+
+    const int file = open("./pipeline.bin", O_WRONLY | O_CREAT | O_TRUNC,
+                          0644);
+    if (file < 0)
+        throw std::runtime_error("cannot open ./pipeline.bin");
+
+    auto load = [&] () -> void {
+        for (uint64_t lower = 0; lower < num_entries; lower += block_rows) {
+            const uint64_t upper = std::min(lower+block_rows, num_entries);
+            const uint64_t slot = free_slots.pop();
+            generate_cbf_range(blocks[slot].data(), labels[slot].data(),
+                               lower, upper, num_features, uint64_t(1),
+                               uint64_t(42), false);
+            loaded.push(job_t{slot, lower, upper});
+        }
+
+        // one end marker per worker
+        for (uint64_t id = 0; id < num_workers; id++)
+            loaded.push(job_t{no_slot, 0, 0});
+    };
+
+    auto compute = [&] () -> void {
+        while (true) {
+            const job_t job = loaded.pop();
+            if (job.slot != no_slot)
+                znormalize(blocks[job.slot].data(), job.upper-job.lower,
+                           num_features);
+            computed.push(job);
+            if (job.slot == no_slot)
+                return;
+        }
+    };
+
+    // blocks arrive out of order, pwrite puts them in place
+    auto dump = [&] () -> void {
+        uint64_t finished = 0;
+        job_t jobs[num_slots];
+        backoff_t backoff;
+
+        while (finished < num_workers) {
+            const uint64_t count = computed.try_pop_bulk(jobs, num_slots);
+            if (!count) {
+                backoff();
+                continue;
+            }
+            backoff.reset();
+
+            for (uint64_t index = 0; index < count; index++) {
+                const job_t& job = jobs[index];
+                if (job.slot == no_slot) {
+                    finished++;
+                    continue;
+                }
+                const uint64_t bytes = (job.upper-job.lower)*
+                                       num_features*sizeof(float);
+                if (pwrite(file, blocks[job.slot].data(), bytes,
+                           job.lower*num_features*sizeof(float)) !=
+                    ssize_t(bytes))
+                    throw std::runtime_error("cannot write ./pipeline.bin");
+                free_slots.push(job.slot);
+            }
+        }
+    };
+
+    TIMERSTART(pipeline)
+    std::vector<std::thread> threads;
+    threads.emplace_back(load);
+    for (uint64_t id = 0; id < num_workers; id++)
+        threads.emplace_back(compute);
+    threads.emplace_back(dump);
+    for (auto& thread : threads)
+        thread.join();
+    TIMERSTOP(pipeline)
+
+    close(file);
+
+    std::cout << "# " << num_entries << " series of length "
+              << num_features << " through " << num_workers
+              << " compute stages" << std::endl;
+}
@@ -3,12 +3,25 @@
 
 #include <cstdint>
 #include <future>
+#include <functional>
 #include <vector>
 #include <queue>
 #include <thread>
 #include <mutex>
 #include <atomic>
-#include <condition_variable>
+
+#include "../include/cache_aligned.hpp" // cache_aligned_t
+#include "../include/futex_event.hpp"   // semaphore_t, event_t
+#include "../include/cpu_topology.hpp"  // pin_policy_t, cpu_topology
+
+// compile with -DTHREADPOOL_MPMC_QUEUE to replace the mutex-protected
+// task queue by the bounded lock-free one from lockfree_queue.hpp
+#ifdef THREADPOOL_MPMC_QUEUE
+    #include "../include/lockfree_queue.hpp" // mpmc_queue_t
+    #ifndef THREADPOOL_QUEUE_CAPACITY
+        #define THREADPOOL_QUEUE_CAPACITY (1UL << 16)
+    #endif
+#endif
 
 class ThreadPool {
 
@@ -16,15 +29,25 @@ private:
 
     // storage for threads and tasks
     std::vector<std::thread> threads;
+#ifdef THREADPOOL_MPMC_QUEUE
+    // tasks that do not fit are run by the enqueuing thread,
+    // queued_tasks counts tasks from before push until after pop
+    mpmc_queue_t<std::function<void(void)>> tasks;
+    cache_aligned_t<std::atomic<uint64_t>> queued_tasks;
+#else
     std::queue<std::function<void(void)>> tasks;
+#endif
 
-    // primitives for signaling
+    // primitives for signaling: one semaphore token per task
+    // (and per thread on stop), the event fires when all is done
     std::mutex mutex;
-    std::condition_variable cv, cv_wait;
+    semaphore_t tasks_available;
+    event_t pool_done;
 
-    // the state of the thread, pool
-    bool stop_pool;
-    std::atomic<uint32_t> active_threads;
+    // the state of the thread, pool: spawn() polls the counter
+    // without the lock, hence keep it off the line of the mutex
+    std::atomic<bool> stop_pool;
+    cache_aligned_t<std::atomic<uint32_t>> active_threads;
     const uint32_t capacity;
 
     // custom task factory
@@ -44,28 +67,50 @@ private:
     
     // will be executed before execution of a task
     void before_task_hook() {
-        active_threads++;
+        (*active_threads)++;
     }
     
+    // no task waiting in the queue
+    bool no_tasks() {
+#ifdef THREADPOOL_MPMC_QUEUE
+        return *queued_tasks == 0;
+#else
+        return tasks.empty();
+#endif
+    }
+
     // will be executed after execution of a task
     void after_task_hook() {
-        active_threads--;
+        (*active_threads)--;
                     
-        if (active_threads == 0 && tasks.empty()) {
+        if (*active_threads == 0 && no_tasks()) {
             stop_pool = true;
-            cv_wait.notify_one();
+            pool_done.set();
         }
     }
 
 public:
+    // the policy defaults to the environment variable THREAD_PIN_POLICY
     ThreadPool(
-        uint64_t capacity_) :
+        uint64_t capacity_,
+        pin_policy_t policy=pin_policy_from_env()) :
+#ifdef THREADPOOL_MPMC_QUEUE
+        tasks(THREADPOOL_QUEUE_CAPACITY),
+        queued_tasks(uint64_t(0)),
+#endif
         stop_pool(false),     // pool is running
         active_threads(0),    // no work to be done
         capacity(capacity_) { // remember size
         
+        // the cpu of every thread, empty if not pinned (numa_local
+        // refers to the node of the thread creating the pool)
+        const auto placed = cpu_topology().placement(policy, capacity);
+
         // this function is executed by the threads
-        auto wait_loop = [this] ( ) -> void {
+        auto wait_loop = [this, placed] (uint64_t id) -> void {
+
+            if (id < placed.size())
+                pin_this_thread(placed[id]);
 
             // wait forever
             while (true) {
@@ -73,22 +118,28 @@ public:
                 // this is a placeholder task
                 std::function<void(void)> task;
 
-                { // lock this section for waiting
-                    std::unique_lock<std::mutex>
-                        unique_lock(mutex);
-
-                    // actions must be performed on
-                    // wake-up if (i) the thread pool
-                    // has been stopped or (ii) there
-                    // are still tasks to be processed
-                    auto predicate = [this] ( ) -> bool {
-                        return  (stop_pool) ||
-                               !(tasks.empty());
-                    };
-
-                    // wait to be waken up on
-                    // aforementioned conditions
-                    cv.wait(unique_lock, predicate);
+                // wait for a token: either a task has been
+                // enqueued or the thread pool has been stopped
+                // (spins briefly, then sleeps on a futex)
+                tasks_available.wait();
+
+#ifdef THREADPOOL_MPMC_QUEUE
+                // a token guarantees a task unless the pool has
+                // been stopped, but its producer may still be
+                // writing the cell: retry until it is visible
+                while (!tasks.try_pop(task)) {
+                    if (stop_pool && no_tasks())
+                        return;
+                    cpu_relax();
+                }
+
+                // count as active before leaving the queue
+                before_task_hook();
+                (*queued_tasks)--;
+#else
+                { // lock this section for extraction
+                    std::lock_guard<std::mutex>
+                        lock_guard(mutex);
 
                     // exit if thread pool stopped
                     // and no tasks to be performed
@@ -100,6 +151,7 @@ public:
                     tasks.pop();                    
                     before_task_hook();
                 } // here we release the lock
+#endif
 
                 // execute the task in parallel
                 task();
@@ -114,7 +166,7 @@ public:
 
         // initially spawn capacity many threads
         for (uint64_t id = 0; id < capacity; id++)
-            threads.emplace_back(wait_loop);
+            threads.emplace_back(wait_loop, id);
     }
 
     ~ThreadPool() {
@@ -129,7 +181,7 @@ public:
         } // here we release the lock
 
         // signal all threads
-        cv.notify_all();
+        tasks_available.post(capacity);
 
         // finally join all threads
         for (auto& thread : threads)
@@ -152,6 +204,29 @@ public:
         auto task_ptr = std::make_shared<decltype(task)>
                         (std::move(task));
 
+#ifdef THREADPOOL_MPMC_QUEUE
+        // you cannot reuse pool after being stopped
+        if (stop_pool)
+            throw std::runtime_error(
+                "enqueue on stopped ThreadPool"
+            );
+
+        auto payload = [task_ptr] ( ) -> void {
+            task_ptr->operator()();
+        };
+
+        // run the task here if the queue is full
+        (*queued_tasks)++;
+        if (!tasks.try_push(payload)) {
+            (*queued_tasks)--;
+            before_task_hook();
+            payload();
+            std::lock_guard<std::mutex>
+                lock_guard(mutex);
+            after_task_hook();
+            return future;
+        }
+#else
         {   // lock the scope
             std::lock_guard<std::mutex>
                 lock_guard(mutex); 
@@ -172,9 +247,10 @@ public:
             // append the task to the queue
             tasks.emplace(payload);
         }
+#endif
 
         // tell one thread to wake-up
-        cv.notify_one();
+        tasks_available.post();
 
         return future;
     }
@@ -188,7 +264,7 @@ public:
         Args && ... args) {
 
         // enqueue if idling threads
-        if (active_threads < capacity)
+        if (*active_threads < capacity)
             enqueue(func, args...);
         // else process sequential
         else
@@ -198,14 +274,7 @@ public:
     void wait_and_stop() {
         
         // wait for pool being set to stop
-        std::unique_lock<std::mutex>
-            unique_lock(mutex);
-        
-        auto predicate = [&] () -> bool {
-            return stop_pool;
-        };
-        
-        cv_wait.wait(unique_lock, predicate);
+        pool_done.wait();
     }
 };
 
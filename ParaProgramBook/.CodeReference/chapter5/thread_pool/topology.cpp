@@ -0,0 +1,32 @@
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+
+#include "../include/cpu_topology.hpp"
+
+// prints the discovered topology and the cpu every policy
+// assigns to the threads of a pool of the given size
+int main(int argc, char * argv[]) {
+
+    const auto& topology = cpu_topology();
+    const uint64_t num_threads = argc > 1 ? atol(argv[1]) :
+                                 topology.logical_cpus().size();
+
+    std::cout << "# " << topology.logical_cpus().size() << " cpus, "
+              << topology.num_cores() << " cores, "
+              << topology.nodes() << " nodes" << std::endl;
+    std::cout << "# cpu\tnode\tpackage\tcore\tsibling" << std::endl;
+    for (const auto& info : topology.logical_cpus())
+        std::cout << info.cpu << "\t" << info.node << "\t" << info.package
+                  << "\t" << info.core << "\t" << info.sibling << std::endl;
+
+    const char * names[] = {"compact", "scatter", "one_per_core",
+                            "numa_local"};
+    for (const auto& name : names) {
+        std::cout << name << "\t";
+        for (const auto& cpu :
+             topology.placement(parse_pin_policy(name), num_threads))
+            std::cout << cpu << " ";
+        std::cout << std::endl;
+    }
+}
@@ -9,6 +9,9 @@
 // binary_IO contains the load_binary function to load
 // and store binary data from and to a file
 #include "../include/binary_IO.hpp"
+// aligned_buffer contains aligned_buffer_t, uninitialized memory
+// on huge pages that is first touched by all threads
+#include "../include/aligned_buffer.hpp"
 
 template <typename value_t,
           typename index_t>
@@ -95,9 +98,9 @@ int main(int argc, char* argv[]) {
     const uint64_t num_test = num_entries-num_train;
 
     // memory for the data matrices and all-pair matrix
-    std::vector<float> input(num_entries*num_features);
-    std::vector<float> label(num_entries*num_classes);
-    std::vector<float> delta(num_test*num_train);
+    aligned_buffer_t<float> input(num_entries*num_features);
+    aligned_buffer_t<float> label(num_entries*num_classes);
+    aligned_buffer_t<float> delta(num_test*num_train);
 
     // get the images and labels from disk
     load_binary(input.data(), input.size(), "./data/X.bin");
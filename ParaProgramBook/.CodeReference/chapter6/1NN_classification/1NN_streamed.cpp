@@ -0,0 +1,126 @@
+#include <iostream>   // std::cout
+#include <limits>     // std::numeric_limits
+#include <vector>     // std::vector
+
+// hpc_helpers contains the TIMERSTART and TIMERSTOP macros
+#include "../include/hpc_helpers.hpp"
+// binary_IO contains the load_binary function to load
+// the (small) test set and the labels from a file
+#include "../include/binary_IO.hpp"
+// stream_IO contains the block_reader_t that streams the
+// (large) training set from disk while we compute
+#include "../include/stream_IO.hpp"
+
+// compares all test samples against one block of training samples
+// and updates the best-so-far distance (bsf) and index (jst) of each
+// test sample: the num_test x num_train matrix delta is never stored
+template <typename value_t,
+          typename index_t>
+void nearest_in_block(const value_t* test,
+                      const value_t* train_block,
+                      value_t* bsf,
+                      index_t* jst,
+                      index_t lower,
+                      index_t upper,
+                      index_t num_test,
+                      index_t num_features,
+                      bool parallel) {
+
+    #pragma omp parallel for if(parallel)
+    for (index_t i = 0; i < num_test; i++)
+        for (index_t j = lower; j < upper; j++) {
+            value_t accum = value_t(0);
+            for (index_t k = 0; k < num_features; k++) {
+                const value_t residue = test[i*num_features+k]
+                                      - train_block[(j-lower)*num_features+k];
+                accum += residue*residue;
+            }
+            if (accum < bsf[i]) {
+                bsf[i] = accum;
+                jst[i] = j;
+            }
+        }
+}
+
+template <typename label_t,
+          typename index_t>
+double accuracy(label_t* label_test,
+                label_t* label_train,
+                index_t* jst,
+                index_t num_test,
+                index_t num_classes) {
+
+    index_t counter = index_t(0);
+
+    for (index_t i = 0; i < num_test; i++) {
+        bool match = true;
+        for (index_t k = 0; k < num_classes; k++)
+            match &= label_test [i     *num_classes+k] ==
+                     label_train[jst[i]*num_classes+k];
+        counter += match;
+    }
+
+    return double(counter)/double(num_test);
+}
+
+int main(int argc, char* argv[]) {
+
+    // run parallelized when any command line argument given
+    const bool parallel = argc > 1;
+
+    std::cout << "running "
+              << (parallel ? "in parallel" : "sequentially")
+              << std::endl;
+
+    // the shape of the data matrices
+    const uint64_t num_features = 28*28;
+    const uint64_t num_classes = 10;
+    const uint64_t num_entries = 65000;
+    const uint64_t num_train = 55000;
+    const uint64_t num_test = num_entries-num_train;
+
+    // training samples per streamed block and number of blocks
+    // in flight: only num_buffers*block_rows training rows
+    // are resident in memory at any time
+    const uint64_t block_rows = 1024;
+    const uint64_t num_buffers = 3;
+
+    // only the test set and the labels are held in memory
+    std::vector<float> test(num_test*num_features);
+    std::vector<float> label(num_entries*num_classes);
+    std::vector<float> bsf(num_test, std::numeric_limits<float>::max());
+    std::vector<uint64_t> jst(num_test, 0);
+
+    load_binary(test.data(), test.size(), "./data/X.bin",
+                num_train*num_features);
+    load_binary(label.data(), label.size(), "./data/Y.bin");
+
+    TIMERSTART(all_vs_all_streamed)
+    block_reader_t<float, uint64_t> reader("./data/X.bin",
+                                           num_train, num_features,
+                                           block_rows, num_buffers);
+
+    std::cout << "streaming with "
+              << (reader.uses_io_uring() ? "io_uring" : "reader thread")
+              << std::endl;
+
+    const float * block;
+    uint64_t lower, length;
+
+    // the next blocks are read while we compute on this one
+    while ((length = reader.acquire(block, lower))) {
+        nearest_in_block(test.data(), block, bsf.data(), jst.data(),
+                         lower, lower+length,
+                         num_test, num_features, parallel);
+        reader.release();
+    }
+    TIMERSTOP(all_vs_all_streamed)
+
+    const uint64_t lbl_off = num_train * num_classes;
+    auto acc = accuracy(label.data() + lbl_off,
+                        label.data(),
+                        jst.data(),
+                        num_test, num_classes);
+
+    std::cout << "test accuracy: " << acc << std::endl;
+}
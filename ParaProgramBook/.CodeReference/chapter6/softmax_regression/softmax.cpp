@@ -1,5 +1,6 @@
 #include "../include/hpc_helpers.hpp"  // timers
 #include "../include/binary_IO.hpp"    // load images
+#include "../include/aligned_buffer.hpp" // aligned_buffer_t
 
 #include <limits>   // numerical limits of data types
 #include <vector>   // std::vector
@@ -184,8 +185,8 @@ int main() {
     const uint64_t num_classes = 10;
     const uint64_t num_entries = 65000;
 
-    std::vector<float> input(num_entries*num_features);
-    std::vector<float> label(num_entries*num_classes);
+    aligned_buffer_t<float> input(num_entries*num_features);
+    aligned_buffer_t<float> label(num_entries*num_classes);
 
     std::vector<float> weights(num_classes*num_features);
     std::vector<float> bias(num_classes);
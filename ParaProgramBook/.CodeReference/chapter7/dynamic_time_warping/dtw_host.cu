@@ -132,7 +132,7 @@ int main () {
 
     // create CBF data set on host
     TIMERSTART(generate_data)
-    generate_cbf(data, labels, num_entries, num_features);
+    generate_cbf_parallel(data, labels, num_entries, num_features);
     TIMERSTOP(generate_data)
 
   
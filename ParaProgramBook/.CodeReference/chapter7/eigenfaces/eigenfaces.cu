@@ -196,11 +196,12 @@ int main (int argc, char * argv[]) {
 
     // write down top-k eigenvectors as image
     TIMERSTART(write_eigenfaces_to_disk)
-    for (uint32_t k = 0; k < 25; k++) {
-        std::string image_name = "imgs/eigenfaces/celebA_eig"
-                               + std::to_string(k)+".bmp";
-        dump_bitmap(eigs+k*rows*cols, rows, cols, image_name);
-    }
+    std::vector<std::string> image_names;
+    for (uint32_t k = 0; k < 25; k++)
+        image_names.push_back("imgs/eigenfaces/celebA_eig"
+                              + std::to_string(k)+".bmp");
+    // all 25 images are encoded and written concurrently
+    dump_bitmaps(eigs, uint64_t(25), rows, cols, image_names);
     std::string binary_name = "data/celebA_eigenfaces_" 
                             + std::to_string(rows*cols) + "_" 
                             + std::to_string(rows*cols) + "_32.bin";
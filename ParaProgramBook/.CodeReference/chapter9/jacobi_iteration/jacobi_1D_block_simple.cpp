@@ -2,49 +2,49 @@
 #include <stdio.h>
 #include <iostream>
 #include <string.h>
+#include <algorithm>
 
 #include "mpi.h"
-
-void readInput(std::string file, int rows, int cols, float *data){
-
-	// Open the file pointer
-	/*FILE* fp = fopen(file.c_str(), "rb");
-
-	// Check if the file exists
-	if(fp == NULL){
-		std::cout << "ERROR: File " << file << " could not be opened" << std::endl;
-		MPI::COMM_WORLD.Abort(1);
+#include "../include/mpi_binary_IO.hpp"
+#include "jacobi_stencil.hpp"
+
+// Every process reads its block (myRows x myCols at rowOffset, colOffset,
+// stored with ld values per row) of the binary matrix file. For the file
+// name "none" the block is filled with the checkerboard.
+// Returns the iteration stored in the file, a checkpoint resumes there.
+int readInput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+              int ld, float *data){
+
+	matrix_header_t header;
+	if(file == "none"){
+		// checkerboard
+		for(int i=0; i<myRows; i++)
+			for(int j=0; j<myCols; j++)
+				data[i*ld+j] = ((rowOffset+i)/121+(colOffset+j)/121) % 2;
+		return 0;
 	}
 
-	for(int i=0; i<rows*cols; i++){
-		if(!fscanf(fp, "%f", &data[i])){
-			std::cout << "ERROR: Not enough values in file " << file << std::endl;
-			MPI::COMM_WORLD.Abort(1);
+	if(!read_matrix_header(file, MPI_COMM_WORLD, header) ||
+	   (header.rows != (uint64_t) rows) || (header.cols != (uint64_t) cols) ||
+	   !read_matrix_block(file, MPI_COMM_WORLD, data, header, rowOffset, colOffset, myRows, myCols, ld)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: File " << file << " is not a " << rows << "x" << cols << " float matrix" << std::endl;
 		}
-	}*/
-
-    // checkerboard
-    for(int i=0; i<rows; i++)
-        for(int j=0; j<cols; j++)
-            data[i*cols+j] = (i/121+j/121) % 2;
+		MPI::COMM_WORLD.Abort(1);
+	}
+	return header.iteration;
 }
 
-void printOutput(std::string file, int rows, int cols, float *data){
+// All processes write their blocks to the binary matrix file at once
+void printOutput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+                 int ld, float *data, int iteration){
 
-	FILE *fp = fopen(file.c_str(), "wb");
-	// Check if the file was opened
-	if(fp == NULL){
-		std::cout << "ERROR: Output file " << file << " could not be opened" << std::endl;
+	if(!write_matrix_block(file, MPI_COMM_WORLD, data, rows, cols, rowOffset, colOffset, myRows, myCols, ld, iteration)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: Output file " << file << " could not be written" << std::endl;
+		}
 		MPI::COMM_WORLD.Abort(1);
 	}
-
-    for(int i=0; i<rows; i++){
-        for(int j=0; j<cols; j++)
-        	fprintf(fp, "%lf ", data[i*cols+j]);
-        fprintf(fp, "\n");
-    }
-
-    fclose(fp);
 }
 
 int main (int argc, char *argv[]){
@@ -61,7 +61,7 @@ int main (int argc, char *argv[]){
 		// Only the first process prints the output message
 		if(!myId){
 			std::cout << "ERROR: The syntax of the program is " << argv[0]
-                                  << " inputFile rows cols outputFile errThreshold"
+                                  << " inputFile rows cols outputFile errThreshold [checkEvery] [checkpointEvery]"
 			          << std::endl;
 		}
 		MPI::COMM_WORLD.Abort(1);
@@ -72,6 +72,10 @@ int main (int argc, char *argv[]){
 	int cols = atoi(argv[3]);
 	std::string outputFile = argv[4];
 	float errThres = atof(argv[5]);
+	// Check the convergence only every checkEvery iterations
+	int checkEvery = argc > 6 ? std::max(1, atoi(argv[6])) : 1;
+	// Write a checkpoint every checkpointEvery iterations, 0 for none
+	int checkpointEvery = argc > 7 ? std::max(0, atoi(argv[7])) : 0;
 
 	if((rows < 1) || (cols < 1)){
 		// Only the first process prints the output message
@@ -89,38 +93,35 @@ int main (int argc, char *argv[]){
 		MPI::COMM_WORLD.Abort(1);
 	}
 
-	float *data;
-
-	// Only one process reads the data from the file and broadcasts the data
-	if(!myId){
-		data = new float[rows*cols];
-		readInput(inputFile, rows, cols, data);
-	}
-
 	// The computation is divided by rows
 	int myRows = rows/numP;
+	int firstRow = myId*myRows;
 
 	// Arrays for the chunk of data to work
 	float *myData = new float[myRows*cols];
 	float *buff = new float[myRows*cols];
 
+	// Every process reads its own rows
+	int iterations = readInput(inputFile, rows, cols, firstRow, 0, myRows, cols, cols, myData);
+	memcpy(buff, myData, myRows*cols*sizeof(float));
+
 	MPI::COMM_WORLD.Barrier();
 
 	// Measure the current time
 	double start = MPI::Wtime();
 
-	// Scatter the input matrix
-	MPI::COMM_WORLD.Scatter(data, myRows*cols, MPI::FLOAT, myData, myRows*cols, MPI::FLOAT, 0);
-	memcpy(buff, myData, myRows*cols*sizeof(float));
-
 	float error = errThres+1.0;
-	float myError;
+	float myError, sendError;
+	MPI_Request errRequest = MPI_REQUEST_NULL;
 
 	// Buffers to receive the rows
 	float *prevRow = new float[cols];
 	float *nextRow = new float[cols];
 
-	while(error > errThres){
+	while(true){
+		// The error is accumulated while updating
+		myError = 0.0;
+
 		if(myId > 0){
 			// Send the first row to the previous process
 			MPI::COMM_WORLD.Send(myData, cols, MPI::FLOAT, myId-1, 0);
@@ -141,56 +142,63 @@ int main (int argc, char *argv[]){
 
 		// Update the first row
 		if((myId > 0) && (myRows>1)){
-			for(int j=1; j<cols-1; j++){
-				buff[j] = 0.25*(myData[cols+j]+myData[j-1]+myData[j+1]+prevRow[j]);
-			}
+			myError += jacobiRow(prevRow, myData, &myData[cols], buff, 1, cols-1);
 		}
 
 		// Update the main block
-		for(int i=1; i<myRows-1; i++){
-			for(int j=1; j<cols-1; j++){
-				// calculate discrete laplacian by averaging 4-neighbourhood
-				buff[i*cols+j]= 0.25f*(myData[(i+1)*cols+j]+myData[i*cols+j-1]+myData[i*cols+j+1]+myData[(i-1)*cols+j]);
-			}
-		}
+		myError += jacobiSweep(myData, buff, cols, 1, myRows-1, 1, cols-1);
 
 		// Update the last row
 		if((myId < numP-1) && (myRows > 1)){
-			for(int j=1; j<cols-1; j++){
-				buff[(myRows-1)*cols+j] = 0.25*(nextRow[j]+myData[(myRows-1)*cols+j-1]+
-						myData[(myRows-1)*cols+j+1]+myData[(myRows-2)*cols+j]);
-			}
+			myError += jacobiRow(&myData[(myRows-2)*cols], &myData[(myRows-1)*cols], nextRow,
+			                     &buff[(myRows-1)*cols], 1, cols-1);
 		}
 
-		// Calculate the error of the block
-		myError = 0.0;
-		for(int i=0; i<myRows; i++){
-			for(int j=1; j<cols-1; j++){
-                // determine difference between 'data' and 'buff' and add up error
-                myError += (myData[i*cols+j]-buff[i*cols+j])*(myData[i*cols+j]-buff[i*cols+j]);
-			}
-		}
+		// The new block becomes the old one, no copy needed
+		std::swap(myData, buff);
 
-		memcpy(myData, buff, myRows*cols*sizeof(float));
+		iterations++;
 
-		// Sum the error of all the processes
-		// The output is stored in the variable 'error' of all processes
-		MPI::COMM_WORLD.Allreduce(&myError, &error, 1, MPI::FLOAT, MPI::SUM);
-	}
+		// The checkpoint is a matrix file that can be used as input
+		if(checkpointEvery && (iterations % checkpointEvery == 0)){
+			printOutput(outputFile+".ckpt", rows, cols, firstRow, 0, myRows, cols, cols, myData, iterations);
+		}
 
-	// Only process 0 writes
-	// Gather the final matrix to the memory of process 0
-	MPI::COMM_WORLD.Gather(myData, myRows*cols, MPI::FLOAT, data, myRows*cols, MPI::FLOAT, 0);
+		// Sum the error of all the processes every checkEvery iterations.
+		// Checking every sweep the blocking reduction stops as soon as the
+		// error is low enough, as jacobi_seq and jacobi_2D_nonblock do.
+		// Otherwise we do not wait: the reduction runs during the next
+		// checkEvery sweeps and is only completed before the next one is
+		// started. These checkEvery extra sweeps only lower the error, so
+		// we stop with the current matrix instead of rolling back.
+		if(checkEvery == 1){
+			MPI::COMM_WORLD.Allreduce(&myError, &error, 1, MPI::FLOAT, MPI::SUM);
+			if(error <= errThres){
+				break;
+			}
+		} else if(iterations % checkEvery == 0){
+			if(errRequest != MPI_REQUEST_NULL){
+				MPI_Wait(&errRequest, MPI_STATUS_IGNORE);
+				if(error <= errThres){
+					break;
+				}
+			}
+			sendError = myError;
+			MPI_Iallreduce(&sendError, &error, 1, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD, &errRequest);
+		}
+	}
 
 	// Measure the current time
 	double end = MPI::Wtime();
 
 	if(!myId){
-    	std::cout << "Time with " << numP << " processes: " << end-start << " seconds" << std::endl;
-    	printOutput(outputFile, rows, cols, data);
-		delete [] data;
+    	std::cout << "Time with " << numP << " processes: " << end-start << " seconds, "
+    	          << iterations << " iterations" << std::endl;
 	}
 
+	// All processes write their rows to the output file
+	printOutput(outputFile, rows, cols, firstRow, 0, myRows, cols, cols, myData, iterations);
+
 	delete [] myData;
 	delete [] buff;
 	delete [] prevRow;
@@ -0,0 +1,263 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <string.h>
+#include <algorithm>
+
+#include "mpi.h"
+#include "../include/mpi_binary_IO.hpp"
+#include "../include/mpi_hybrid.hpp"
+#include "../include/thread_team.hpp"
+#include "jacobi_stencil.hpp"
+#include "../../chapter5/thread_pool/threadpool.hpp"
+
+// Every process reads its block (myRows x myCols at rowOffset, colOffset,
+// stored with ld values per row) of the binary matrix file. For the file
+// name "none" the block is filled with the checkerboard.
+// Returns the iteration stored in the file, a checkpoint resumes there.
+int readInput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+              int ld, float *data){
+
+	matrix_header_t header;
+	if(file == "none"){
+		// checkerboard
+		for(int i=0; i<myRows; i++)
+			for(int j=0; j<myCols; j++)
+				data[i*ld+j] = ((rowOffset+i)/121+(colOffset+j)/121) % 2;
+		return 0;
+	}
+
+	if(!read_matrix_header(file, MPI_COMM_WORLD, header) ||
+	   (header.rows != (uint64_t) rows) || (header.cols != (uint64_t) cols) ||
+	   !read_matrix_block(file, MPI_COMM_WORLD, data, header, rowOffset, colOffset, myRows, myCols, ld)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: File " << file << " is not a " << rows << "x" << cols << " float matrix" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+	return header.iteration;
+}
+
+// All processes write their blocks to the binary matrix file at once
+void printOutput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+                 int ld, float *data, int iteration){
+
+	if(!write_matrix_block(file, MPI_COMM_WORLD, data, rows, cols, rowOffset, colOffset, myRows, myCols, ld, iteration)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: Output file " << file << " could not be written" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+}
+
+int main (int argc, char *argv[]){
+	// Initialize MPI, one thread at a time calls MPI: the main thread
+	// outside of the iterations and the first worker inside
+	init_mpi_threads(argc, argv, MPI_THREAD_SERIALIZED);
+
+	// Get the number of processes
+	int numP=MPI::COMM_WORLD.Get_size();
+
+	// Get the ID of the process
+	int myId=MPI::COMM_WORLD.Get_rank();
+
+	if(argc < 6){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: The syntax of the program is " << argv[0]
+			          << " inputFile rows cols outputFile errThreshold [checkEvery] [checkpointEvery] [threads]"
+			          << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	std::string inputFile = argv[1];
+	int rows = atoi(argv[2]);
+	int cols = atoi(argv[3]);
+	std::string outputFile = argv[4];
+	float errThres = atof(argv[5]);
+	// Check the convergence only every checkEvery iterations
+	int checkEvery = argc > 6 ? std::max(1, atoi(argv[6])) : 1;
+	// Write a checkpoint every checkpointEvery iterations, 0 for none
+	int checkpointEvery = argc > 7 ? std::max(0, atoi(argv[7])) : 0;
+	// By default one thread per core the process is bound to
+	int numThreads = argc > 8 ? atoi(argv[8]) : cpu_topology().num_cores();
+
+	if((rows < 1) || (cols < 1) || (numThreads < 1)){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: The number of rows, columns and threads must be higher than 0" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	// The computation is divided by rows
+	int blockRows = rows/numP;
+	int myRows = blockRows;
+
+	// For the cases that 'rows' is not multiple of numP
+	if(myId < rows%numP){
+		myRows++;
+	}
+	int firstRow = myId*blockRows + std::min(myId, rows%numP);
+
+	// Arrays for the chunk of data to work, shared by the threads
+	float *myData = new float[myRows*cols];
+	float *buff = new float[myRows*cols];
+
+	// Every process reads its own rows
+	int iterations = readInput(inputFile, rows, cols, firstRow, 0, myRows, cols, cols, myData);
+	memcpy(buff, myData, myRows*cols*sizeof(float));
+
+	// Measure the current time
+	double start = MPI::Wtime();
+
+	float error = errThres+1.0;
+	float sendError;
+	MPI_Request errRequest = MPI_REQUEST_NULL;
+
+	// Buffers to receive the rows, one pair per process instead of one
+	// per core
+	float *prevRow = new float[cols];
+	float *nextRow = new float[cols];
+
+	// The threads stay in the pool for all the iterations and meet at a
+	// barrier after every sweep, the error of each thread on its own line
+	sense_barrier_t barrier(numThreads);
+	padded_array_t<float> threadError(numThreads, 0.0f);
+	bool done = false;
+
+	// Every thread updates a block of the inner rows, the first one also
+	// exchanges the rows with the neighbours and updates the first and the
+	// last row once they arrived
+	auto worker = [&] (int id){
+		uint32_t sense = 0;
+		float *src = myData, *dst = buff;
+		int iteration = iterations;
+
+		int inner = std::max(myRows-2, 0);
+		int r0 = 1 + id*(inner/numThreads) + std::min(id, inner%numThreads);
+		int r1 = r0 + inner/numThreads + (id < inner%numThreads);
+
+		MPI_Request request[4] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+
+		while(true){
+			if(!id){
+				if(myId > 0){
+					MPI_Isend(src, cols, MPI_FLOAT, myId-1, 0, MPI_COMM_WORLD, &request[0]);
+					MPI_Irecv(prevRow, cols, MPI_FLOAT, myId-1, 0, MPI_COMM_WORLD, &request[1]);
+				}
+				if(myId < numP-1){
+					MPI_Isend(&src[(myRows-1)*cols], cols, MPI_FLOAT, myId+1, 0, MPI_COMM_WORLD, &request[2]);
+					MPI_Irecv(nextRow, cols, MPI_FLOAT, myId+1, 0, MPI_COMM_WORLD, &request[3]);
+				}
+			}
+
+			// Update the inner rows of this thread
+			float myError = 0.0;
+			for(int r=r0; r<r1; r++){
+				myError += jacobiRow(&src[(r-1)*cols], &src[r*cols], &src[(r+1)*cols], &dst[r*cols], 1, cols-1);
+			}
+
+			// Update the first and the last row
+			if(!id){
+				MPI_Waitall(4, request, MPI_STATUSES_IGNORE);
+				if((myId > 0) && (myRows > 1)){
+					myError += jacobiRow(prevRow, src, &src[cols], dst, 1, cols-1);
+				}
+				if((myId < numP-1) && (myRows > 1)){
+					myError += jacobiRow(&src[(myRows-2)*cols], &src[(myRows-1)*cols], nextRow,
+					                     &dst[(myRows-1)*cols], 1, cols-1);
+				}
+			}
+			threadError[id] = myError;
+			barrier.arrive_and_wait(sense);
+
+			// The new block becomes the old one, no copy needed
+			std::swap(src, dst);
+
+			iteration++;
+
+			if(!id){
+				// The checkpoint is a matrix file that can be used as input
+				if(checkpointEvery && (iteration % checkpointEvery == 0)){
+					printOutput(outputFile+".ckpt", rows, cols, firstRow, 0, myRows, cols, cols, src, iteration);
+				}
+
+				// The same reduction of the error as in jacobi_1D_nonblock,
+				// blocking when checking every sweep and delayed otherwise.
+				// The sum of the threads is only read here and no thread
+				// overwrites it before the barrier below
+				if(checkEvery == 1){
+					sendError = 0.0;
+					for(int t=0; t<numThreads; t++){
+						sendError += threadError[t];
+					}
+					MPI_Allreduce(&sendError, &error, 1, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+					done = error <= errThres;
+				} else if(iteration % checkEvery == 0){
+					if(errRequest != MPI_REQUEST_NULL){
+						MPI_Wait(&errRequest, MPI_STATUS_IGNORE);
+						done = error <= errThres;
+					}
+					if(!done){
+						sendError = 0.0;
+						for(int t=0; t<numThreads; t++){
+							sendError += threadError[t];
+						}
+						MPI_Iallreduce(&sendError, &error, 1, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD, &errRequest);
+					}
+				}
+			}
+
+			if(iteration % checkEvery == 0){
+				barrier.arrive_and_wait(sense);
+				if(done){
+					break;
+				}
+			}
+		}
+
+		if(!id){
+			myData = src;
+			buff = dst;
+			iterations = iteration;
+		}
+	};
+
+	// The first task enqueues the other workers, all of them must run at
+	// once since they wait for each other at the barriers
+	ThreadPool pool(numThreads);
+	pool.enqueue([&] (){
+		for(int t=1; t<numThreads; t++){
+			pool.enqueue(worker, t);
+		}
+		worker(0);
+	});
+	pool.wait_and_stop();
+
+	// Measure the current time
+	double end = MPI::Wtime();
+
+	// The peak memory of the busiest node
+	unsigned long long myNodeMemory = node_peak_memory_bytes(MPI_COMM_WORLD), nodeMemory;
+	MPI_Reduce(&myNodeMemory, &nodeMemory, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+
+	if(!myId){
+		std::cout << "Time with " << numP << " processes and " << numThreads << " threads per process: "
+		          << end-start << " seconds, " << iterations << " iterations, peak memory per node "
+		          << (nodeMemory >> 20) << " MB" << std::endl;
+	}
+
+	// All processes write their rows to the output file
+	printOutput(outputFile, rows, cols, firstRow, 0, myRows, cols, cols, myData, iterations);
+
+	delete [] myData;
+	delete [] buff;
+	delete [] prevRow;
+	delete [] nextRow;
+
+	// Terminate MPI
+	MPI::Finalize();
+	return 0;
+}
@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <string.h>
+#include <algorithm>
+
+#include "mpi.h"
+#include "../include/mpi_binary_IO.hpp"
+#include "jacobi_stencil.hpp"
+
+// Directions of the halo messages, also used as tags: a message
+// travelling north is received from the south neighbor with tag NORTH
+enum {NORTH, SOUTH, WEST, EAST, NORTHWEST, NORTHEAST, SOUTHWEST, SOUTHEAST};
+
+// Every process reads its block (myRows x myCols at rowOffset, colOffset,
+// stored with ld values per row) of the binary matrix file. For the file
+// name "none" the block is filled with the checkerboard.
+// Returns the iteration stored in the file, a checkpoint resumes there.
+int readInput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+              int ld, float *data){
+
+	matrix_header_t header;
+	if(file == "none"){
+		// checkerboard
+		for(int i=0; i<myRows; i++)
+			for(int j=0; j<myCols; j++)
+				data[i*ld+j] = ((rowOffset+i)/121+(colOffset+j)/121) % 2;
+		return 0;
+	}
+
+	if(!read_matrix_header(file, MPI_COMM_WORLD, header) ||
+	   (header.rows != (uint64_t) rows) || (header.cols != (uint64_t) cols) ||
+	   !read_matrix_block(file, MPI_COMM_WORLD, data, header, rowOffset, colOffset, myRows, myCols, ld)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: File " << file << " is not a " << rows << "x" << cols << " float matrix" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+	return header.iteration;
+}
+
+// All processes write their blocks to the binary matrix file at once
+void printOutput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+                 int ld, float *data, int iteration){
+
+	if(!write_matrix_block(file, MPI_COMM_WORLD, data, rows, cols, rowOffset, colOffset, myRows, myCols, ld, iteration)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: Output file " << file << " could not be written" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+}
+
+// Rows (or columns) of the block of coordinate 'coord' if 'length'
+// is split into 'parts' blocks, the first length%parts get one more
+void blockRange(int length, int parts, int coord, int &offset, int &size){
+	size = length/parts + (coord < length%parts);
+	offset = coord*(length/parts) + std::min(coord, length%parts);
+}
+
+int main (int argc, char *argv[]){
+	// Initialize MPI
+	MPI::Init(argc,argv);
+
+	// Get the number of processes
+	int numP=MPI::COMM_WORLD.Get_size();
+
+	// Get the ID of the process
+	int myId=MPI::COMM_WORLD.Get_rank();
+
+	if(argc < 6){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: The syntax of the program is ./jacobi_2D_nonblock inputFile rows cols outputFile errThreshold [haloWidth] [checkpointEvery]"
+					<< std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	std::string inputFile = argv[1];
+	int rows = atoi(argv[2]);
+	int cols = atoi(argv[3]);
+	std::string outputFile = argv[4];
+	float errThres = atof(argv[5]);
+	// A halo of width h allows h sweeps per exchange
+	int halo = argc > 6 ? atoi(argv[6]) : 1;
+	// Write a checkpoint every checkpointEvery iterations, 0 for none
+	int checkpointEvery = argc > 7 ? std::max(0, atoi(argv[7])) : 0;
+
+	if((rows < 1) || (cols < 1) || (halo < 1)){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: The number of rows, columns and the halo width must be higher than 0" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	// Arrange the processes in a 2D grid, no periodic boundaries
+	int dims[2] = {0, 0};
+	bool periods[2] = {false, false};
+	MPI::Compute_dims(numP, 2, dims);
+	MPI::Cartcomm cart = MPI::COMM_WORLD.Create_cart(2, dims, periods, true);
+	myId = cart.Get_rank();
+
+	int coords[2];
+	cart.Get_coords(myId, 2, coords);
+
+	// The block of the process and its offset in the global matrix
+	int myRows, myCols, rowOffset, colOffset;
+	blockRange(rows, dims[0], coords[0], rowOffset, myRows);
+	blockRange(cols, dims[1], coords[1], colOffset, myCols);
+
+	if((myRows < halo) || (myCols < halo)){
+		if(!myId){
+			std::cout << "ERROR: Every block must have at least haloWidth rows and columns" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	// The neighbors in all 8 directions (PROC_NULL at the border)
+	int neighbor[8];
+	cart.Shift(0, 1, neighbor[NORTH], neighbor[SOUTH]);
+	cart.Shift(1, 1, neighbor[WEST], neighbor[EAST]);
+	const int diagonal[4][2] = {{-1,-1}, {-1,1}, {1,-1}, {1,1}};
+	for(int d=0; d<4; d++){
+		int other[2] = {coords[0]+diagonal[d][0], coords[1]+diagonal[d][1]};
+		if((other[0] < 0) || (other[0] >= dims[0]) || (other[1] < 0) || (other[1] >= dims[1])){
+			neighbor[NORTHWEST+d] = MPI::PROC_NULL;
+		} else {
+			neighbor[NORTHWEST+d] = cart.Get_cart_rank(other);
+		}
+	}
+
+	// The local block is surrounded by a halo of width 'halo'
+	const int height = myRows+2*halo;
+	const int width = myCols+2*halo;
+	float *myData = new float[height*width];
+	float *buff = new float[height*width];
+	memset(myData, 0, height*width*sizeof(float));
+
+	// Derived datatypes: halo rows and columns are strided in memory
+	MPI::Datatype rowHalo = MPI::FLOAT.Create_vector(halo, myCols, width);
+	MPI::Datatype colHalo = MPI::FLOAT.Create_vector(myRows, halo, width);
+	MPI::Datatype cornerHalo = MPI::FLOAT.Create_vector(halo, halo, width);
+	rowHalo.Commit();
+	colHalo.Commit();
+	cornerHalo.Commit();
+
+	// Every process reads its own block into the middle of the local array
+	int iterations = readInput(inputFile, rows, cols, rowOffset, colOffset, myRows, myCols, width,
+	                           &myData[halo*width+halo]);
+	int firstIteration = iterations, lastCheckpoint = iterations;
+
+	// Measure the current time
+	double start = MPI::Wtime();
+
+	// Where to send and receive each halo: (row, column) in the local array
+	const int h = halo;
+	const int sendAt[8][2] = {{h,h}, {myRows,h}, {h,h}, {h,myCols},
+	                          {h,h}, {h,myCols}, {myRows,h}, {myRows,myCols}};
+	const int recvAt[8][2] = {{myRows+h,h}, {0,h}, {h,myCols+h}, {h,0},
+	                          {myRows+h,myCols+h}, {myRows+h,0}, {0,myCols+h}, {0,0}};
+	const MPI::Datatype *haloType[8] = {&rowHalo, &rowHalo, &colHalo, &colHalo,
+	                                    &cornerHalo, &cornerHalo, &cornerHalo, &cornerHalo};
+	// The message travelling in direction d comes from the opposite side
+	const int opposite[8] = {SOUTH, NORTH, EAST, WEST, SOUTHEAST, SOUTHWEST, NORTHEAST, NORTHWEST};
+	// Corners are only read by the second and later sweeps
+	const int numDirections = halo > 1 ? 8 : 4;
+
+	// Only the interior of the global matrix is updated, in local indices
+	const int firstRow = 1-rowOffset+halo, lastRow = rows-1-rowOffset+halo;
+	const int firstCol = 1-colOffset+halo, lastCol = cols-1-colOffset+halo;
+
+	MPI::Request request[16];
+
+	// Post all halo messages
+	auto postHalos = [&] (){
+		for(int d=0; d<numDirections; d++){
+			request[2*d] = cart.Isend(&myData[sendAt[d][0]*width+sendAt[d][1]], 1, *haloType[d], neighbor[d], d);
+			request[2*d+1] = cart.Irecv(&myData[recvAt[d][0]*width+recvAt[d][1]], 1, *haloType[d],
+			                            neighbor[opposite[d]], d);
+		}
+	};
+
+	// Halo cells on the global border are never updated, both arrays
+	// need them for the sweeps that extend into the halo
+	postHalos();
+	MPI::Request::Waitall(2*numDirections, request);
+	memcpy(buff, myData, height*width*sizeof(float));
+
+	float error = errThres+1.0;
+	float myError;
+
+	while(error > errThres){
+		postHalos();
+
+		myError = 0.0;
+		for(int k=0; k<halo; k++){
+			// Sweep k may extend h-1-k cells into the halo
+			const int r0 = std::max(1+k, firstRow), r1 = std::min(height-1-k, lastRow);
+			const int c0 = std::max(1+k, firstCol), c1 = std::min(width-1-k, lastCol);
+
+			if(k == 0){
+				// The cells that do not read the halo overlap the communication
+				const int i0 = std::max(r0, h+1), i1 = std::min(r1, h+myRows-1);
+				const int j0 = std::max(c0, h+1), j1 = std::min(c1, h+myCols-1);
+				float inner = 0.0;
+				if((i0 < i1) && (j0 < j1)){
+					inner = jacobiSweep(myData, buff, width, i0, i1, j0, j1);
+				}
+
+				MPI::Request::Waitall(2*numDirections, request);
+
+				// The frame around the inner cells
+				float frame = 0.0;
+				if((i0 < i1) && (j0 < j1)){
+					frame += jacobiSweep(myData, buff, width, r0, i0, c0, c1);
+					frame += jacobiSweep(myData, buff, width, i1, r1, c0, c1);
+					frame += jacobiSweep(myData, buff, width, i0, i1, c0, j0);
+					frame += jacobiSweep(myData, buff, width, i0, i1, j1, c1);
+				} else {
+					frame = jacobiSweep(myData, buff, width, r0, r1, c0, c1);
+				}
+				myError = inner+frame;
+			} else {
+				myError = jacobiSweep(myData, buff, width, r0, r1, c0, c1);
+			}
+
+			// Only the last sweep stays within the owned block, the
+			// error of the earlier ones would count halo cells twice
+			std::swap(myData, buff);
+			iterations++;
+		}
+
+		// Sum the error of the last sweep of all the processes
+		cart.Allreduce(&myError, &error, 1, MPI::FLOAT, MPI::SUM);
+
+		// The checkpoint is a matrix file that can be used as input
+		if(checkpointEvery && (iterations >= lastCheckpoint+checkpointEvery)){
+			printOutput(outputFile+".ckpt", rows, cols, rowOffset, colOffset, myRows, myCols, width,
+			            &myData[halo*width+halo], iterations);
+			lastCheckpoint = iterations;
+		}
+	}
+
+	// Measure the current time
+	double end = MPI::Wtime();
+
+	if(!myId){
+		std::cout << "Time with " << numP << " processes (" << dims[0] << "x" << dims[1]
+		          << " grid, halo " << halo << "): " << end-start << " seconds, "
+		          << iterations << " iterations (" << 1E6*(end-start)/(iterations-firstIteration)
+		          << " us per iteration)" << std::endl;
+	}
+
+	// All processes write their blocks to the output file
+	printOutput(outputFile, rows, cols, rowOffset, colOffset, myRows, myCols, width,
+	            &myData[halo*width+halo], iterations);
+
+	rowHalo.Free();
+	colHalo.Free();
+	cornerHalo.Free();
+	cart.Free();
+
+	delete [] myData;
+	delete [] buff;
+
+	// Terminate MPI
+	MPI::Finalize();
+	return 0;
+}
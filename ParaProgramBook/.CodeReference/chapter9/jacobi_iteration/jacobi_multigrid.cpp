@@ -0,0 +1,426 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "mpi.h"
+#include "../include/mpi_binary_IO.hpp"
+#include "jacobi_stencil.hpp"
+
+// Every process reads its block (myRows x myCols at rowOffset, colOffset,
+// stored with ld values per row) of the binary matrix file. For the file
+// name "none" the block is filled with the checkerboard.
+// Returns the iteration stored in the file, a checkpoint resumes there.
+int readInput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+              int ld, float *data){
+
+	matrix_header_t header;
+	if(file == "none"){
+		// checkerboard
+		for(int i=0; i<myRows; i++)
+			for(int j=0; j<myCols; j++)
+				data[i*ld+j] = ((rowOffset+i)/121+(colOffset+j)/121) % 2;
+		return 0;
+	}
+
+	if(!read_matrix_header(file, MPI_COMM_WORLD, header) ||
+	   (header.rows != (uint64_t) rows) || (header.cols != (uint64_t) cols) ||
+	   !read_matrix_block(file, MPI_COMM_WORLD, data, header, rowOffset, colOffset, myRows, myCols, ld)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: File " << file << " is not a " << rows << "x" << cols << " float matrix" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+	return header.iteration;
+}
+
+// All processes write their blocks to the binary matrix file at once
+void printOutput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+                 int ld, float *data, int iteration){
+
+	if(!write_matrix_block(file, MPI_COMM_WORLD, data, rows, cols, rowOffset, colOffset, myRows, myCols, ld, iteration)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: Output file " << file << " could not be written" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+}
+
+// Smoothing sweeps before and after the coarse grid correction, their
+// weight (4/5 damps the high frequencies of the 5-point stencil best)
+// and the plain Jacobi sweeps that solve the coarsest level
+const int preSweeps = 2;
+const int postSweeps = 2;
+const float omega = 0.8f;
+const int coarseSweeps = 64;
+
+// One level of the grid hierarchy. Every process of 'comm' owns the rows
+// [first, first+myRows) of the rows x cols grid and stores them with one
+// halo row above and below. Level 0 holds the solution, the coarser
+// levels the correction for the residual of the next finer level.
+struct Level {
+	MPI::Intracomm comm;
+	int myId, numP;
+	int rows, cols;
+	int first, myRows;
+	bool coarsest;
+
+	std::vector<float> u, tmp, f, r;
+
+	// The next level is agglomerated on process 0 of comm: the rows
+	// [cFirst, cFirst+cRows) are restricted here and gathered, the rows
+	// [sFirst, sFirst+sRows) of the correction are sent back
+	bool gather;
+	int cFirst, cRows, sFirst, sRows;
+	std::vector<int> gatherCounts, gatherDispls, scatterCounts, scatterDispls;
+	std::vector<float> buff;
+};
+
+// The rows of the coarse level that follow from owning the fine rows
+// [first, first+myRows): coarse row I lies on fine row 2I. For an even
+// number of fine rows the last coarse row lies beyond the last fine row,
+// it is a boundary row that goes to the last process.
+void coarseRange(int rows, int first, int myRows, bool last, int &cFirst, int &cRows){
+	cFirst = (first+1)/2;
+	int cEnd = last ? rows/2+1 : (first+myRows+1)/2;
+	cRows = cEnd-cFirst;
+}
+
+void allocate(Level &level){
+	int size = (level.myRows+2)*level.cols;
+	level.u.assign(size, 0.0f);
+	level.tmp.assign(size, 0.0f);
+	level.r.assign(size, 0.0f);
+}
+
+// The local rows of the interior of the global grid
+int firstInner(const Level &level){
+	return std::max(level.first, 1)-level.first+1;
+}
+
+int lastInner(const Level &level){
+	return std::min(level.first+level.myRows, level.rows-1)-level.first+1;
+}
+
+const float *rhs(const Level &level){
+	return level.f.empty() ? nullptr : level.f.data();
+}
+
+void exchangeHalos(Level &level, float *data){
+	int cols = level.cols;
+	int up = level.myId > 0 ? level.myId-1 : MPI::PROC_NULL;
+	int down = level.myId < level.numP-1 ? level.myId+1 : MPI::PROC_NULL;
+
+	// The first row goes up while the lower halo comes from below
+	level.comm.Sendrecv(&data[cols], cols, MPI::FLOAT, up, 0,
+	                    &data[(level.myRows+1)*cols], cols, MPI::FLOAT, down, 0);
+	level.comm.Sendrecv(&data[level.myRows*cols], cols, MPI::FLOAT, down, 1,
+	                    data, cols, MPI::FLOAT, up, 1);
+}
+
+// Weighted Jacobi sweeps, returns the squared change of the last one
+float smooth(Level &level, int sweeps, float weight){
+	float error = 0.0;
+	for(int s=0; s<sweeps; s++){
+		exchangeHalos(level, level.u.data());
+		error = jacobiSweep(level.u.data(), level.tmp.data(), level.cols, firstInner(level), lastInner(level),
+		                    1, level.cols-1, rhs(level), weight);
+		std::swap(level.u, level.tmp);
+	}
+	return error;
+}
+
+// r = f-Au on the interior, with halos. The plain Jacobi update differs
+// from u by a quarter of the residual, so one sweep into tmp gives it.
+void residual(Level &level){
+	int cols = level.cols;
+	exchangeHalos(level, level.u.data());
+	jacobiSweep(level.u.data(), level.tmp.data(), cols, firstInner(level), lastInner(level),
+	            1, cols-1, rhs(level), 1.0f);
+	for(int i=firstInner(level); i<lastInner(level); i++){
+		for(int j=1; j<cols-1; j++){
+			level.r[i*cols+j] = 4.0f*(level.tmp[i*cols+j]-level.u[i*cols+j]);
+		}
+	}
+	exchangeHalos(level, level.r.data());
+}
+
+// Full weighting of the residual to the coarse rows [cFirst, cFirst+cRows),
+// stored in dst with dst row 0 being coarse row 'base'. The coarse grid
+// spacing is twice the fine one, hence the right hand side is 4 times
+// the restricted residual.
+void restrictResidual(const Level &level, float *dst, int cFirst, int cRows, int base){
+	int cols = level.cols;
+	int cCols = cols/2+1;
+	int cLast = level.rows/2;
+	const float *r = level.r.data();
+
+	for(int I=std::max(cFirst, 1); I<std::min(cFirst+cRows, cLast); I++){
+		int i = 2*I-level.first+1;
+		for(int J=1; J<cCols-1; J++){
+			int j = 2*J;
+			dst[(I-base)*cCols+J] = 0.25f*(4.0f*r[i*cols+j]
+			    +2.0f*(r[(i-1)*cols+j]+r[(i+1)*cols+j]+r[i*cols+j-1]+r[i*cols+j+1])
+			    +r[(i-1)*cols+j-1]+r[(i-1)*cols+j+1]+r[(i+1)*cols+j-1]+r[(i+1)*cols+j+1]);
+		}
+	}
+}
+
+// Adds the bilinear interpolation of the coarse correction src, whose
+// row 0 is coarse row 'base', to the interior of the fine level
+void prolongate(Level &level, const float *src, int base){
+	int cols = level.cols;
+	int cCols = cols/2+1;
+
+	for(int i=firstInner(level); i<lastInner(level); i++){
+		int global = level.first+i-1;
+		const float *a = &src[(global/2-base)*cCols];
+		const float *b = global%2 ? &src[(global/2+1-base)*cCols] : a;
+		for(int j=1; j<cols-1; j++){
+			int J = j/2;
+			float ea = j%2 ? 0.5f*(a[J]+a[J+1]) : a[J];
+			float eb = j%2 ? 0.5f*(b[J]+b[J+1]) : b[J];
+			level.u[i*cols+j] += 0.5f*(ea+eb);
+		}
+	}
+}
+
+// Coarsens the grid until it has a single interior row or column. Coarse
+// rows stay on the process that owns their fine row as long as every
+// process keeps at least minRows rows, the rest of the hierarchy is
+// agglomerated on process 0 (the other processes stop building there).
+std::vector<Level> buildLevels(int rows, int cols, int minRows){
+	std::vector<Level> levels(1);
+	Level *fine = &levels[0];
+	fine->comm = MPI::COMM_WORLD;
+	fine->numP = fine->comm.Get_size();
+	fine->myId = fine->comm.Get_rank();
+	fine->rows = rows;
+	fine->cols = cols;
+	fine->myRows = rows/fine->numP + (fine->myId < rows%fine->numP);
+	fine->first = fine->myId*(rows/fine->numP) + std::min(fine->myId, rows%fine->numP);
+	allocate(*fine);
+
+	while(true){
+		fine->gather = false;
+		fine->coarsest = (fine->rows < 4) || (fine->cols < 4);
+		if(fine->coarsest){
+			break;
+		}
+
+		Level coarse;
+		coarse.rows = fine->rows/2+1;
+		coarse.cols = fine->cols/2+1;
+
+		// The coarse rows of all processes
+		std::vector<int> firsts(fine->numP), counts(fine->numP), all(2*fine->numP);
+		int mine[2] = {fine->first, fine->myRows};
+		fine->comm.Allgather(mine, 2, MPI::INT, all.data(), 2, MPI::INT);
+		int fewest = coarse.rows;
+		for(int p=0; p<fine->numP; p++){
+			coarseRange(fine->rows, all[2*p], all[2*p+1], p == fine->numP-1, firsts[p], counts[p]);
+			fewest = std::min(fewest, counts[p]);
+		}
+
+		if((fine->numP == 1) || (fewest >= minRows)){
+			coarse.comm = fine->comm;
+			coarse.myId = fine->myId;
+			coarse.numP = fine->numP;
+			coarse.first = firsts[fine->myId];
+			coarse.myRows = counts[fine->myId];
+		} else {
+			fine->gather = true;
+			fine->cFirst = firsts[fine->myId];
+			fine->cRows = counts[fine->myId];
+			// The correction is needed one row beyond the own rows
+			fine->sFirst = std::max(fine->cFirst-1, 0);
+			fine->sRows = std::min(fine->cFirst+fine->cRows+1, coarse.rows)-fine->sFirst;
+			fine->buff.assign((fine->cRows+2)*coarse.cols, 0.0f);
+
+			if(!fine->myId){
+				fine->gatherCounts.resize(fine->numP);
+				fine->gatherDispls.resize(fine->numP);
+				fine->scatterCounts.resize(fine->numP);
+				fine->scatterDispls.resize(fine->numP);
+				for(int p=0; p<fine->numP; p++){
+					// Row 0 of the agglomerated level is its upper halo
+					int sFirst = std::max(firsts[p]-1, 0);
+					int sEnd = std::min(firsts[p]+counts[p]+1, coarse.rows);
+					fine->gatherCounts[p] = counts[p]*coarse.cols;
+					fine->gatherDispls[p] = (firsts[p]+1)*coarse.cols;
+					fine->scatterCounts[p] = (sEnd-sFirst)*coarse.cols;
+					fine->scatterDispls[p] = (sFirst+1)*coarse.cols;
+				}
+			} else {
+				// The other processes do not take part in the coarser levels
+				break;
+			}
+
+			coarse.comm = MPI::COMM_SELF;
+			coarse.myId = 0;
+			coarse.numP = 1;
+			coarse.first = 0;
+			coarse.myRows = coarse.rows;
+		}
+
+		allocate(coarse);
+		coarse.f.assign(coarse.u.size(), 0.0f);
+		levels.push_back(coarse);
+		fine = &levels.back();
+	}
+
+	return levels;
+}
+
+// One V-cycle (gamma = 1) or W-cycle (gamma = 2) starting at level l
+void cycle(std::vector<Level> &levels, int l, int gamma){
+	Level &level = levels[l];
+
+	if(level.coarsest){
+		smooth(level, coarseSweeps, 1.0f);
+		return;
+	}
+
+	smooth(level, preSweeps, omega);
+	residual(level);
+
+	if(level.gather){
+		Level *coarse = level.myId ? nullptr : &levels[l+1];
+		int cCols = level.cols/2+1;
+
+		restrictResidual(level, level.buff.data(), level.cFirst, level.cRows, level.cFirst);
+		level.comm.Gatherv(level.buff.data(), level.cRows*cCols, MPI::FLOAT,
+		                   coarse ? coarse->f.data() : nullptr, level.gatherCounts.data(),
+		                   level.gatherDispls.data(), MPI::FLOAT, 0);
+
+		if(coarse){
+			std::fill(coarse->u.begin(), coarse->u.end(), 0.0f);
+			for(int k=0; k<gamma; k++){
+				cycle(levels, l+1, gamma);
+			}
+		}
+
+		// Overlapping pieces of the correction go back, each process
+		// gets the rows it interpolates from. A scatter must not read a
+		// row twice, hence point-to-point messages
+		if(coarse){
+			std::vector<MPI::Request> requests;
+			for(int p=1; p<level.numP; p++){
+				requests.push_back(level.comm.Isend(&coarse->u[level.scatterDispls[p]], level.scatterCounts[p],
+				                                    MPI::FLOAT, p, 2));
+			}
+			std::copy(&coarse->u[level.scatterDispls[0]], &coarse->u[level.scatterDispls[0]+level.scatterCounts[0]],
+			          level.buff.begin());
+			MPI::Request::Waitall(requests.size(), requests.data());
+		} else {
+			level.comm.Recv(level.buff.data(), level.sRows*cCols, MPI::FLOAT, 0, 2);
+		}
+		prolongate(level, level.buff.data(), level.sFirst);
+	} else {
+		Level &coarse = levels[l+1];
+
+		restrictResidual(level, coarse.f.data(), coarse.first, coarse.myRows, coarse.first-1);
+		std::fill(coarse.u.begin(), coarse.u.end(), 0.0f);
+		for(int k=0; k<gamma; k++){
+			cycle(levels, l+1, gamma);
+		}
+
+		exchangeHalos(coarse, coarse.u.data());
+		prolongate(level, coarse.u.data(), coarse.first-1);
+	}
+
+	smooth(level, postSweeps, omega);
+}
+
+int main (int argc, char *argv[]){
+	// Initialize MPI
+	MPI::Init(argc,argv);
+
+	// Get the number of processes
+	int numP=MPI::COMM_WORLD.Get_size();
+
+	// Get the ID of the process
+	int myId=MPI::COMM_WORLD.Get_rank();
+
+	if(argc < 6){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: The syntax of the program is " << argv[0]
+			          << " inputFile rows cols outputFile errThreshold [V|W] [minRows] [checkpointEvery]"
+			          << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	std::string inputFile = argv[1];
+	int rows = atoi(argv[2]);
+	int cols = atoi(argv[3]);
+	std::string outputFile = argv[4];
+	float errThres = atof(argv[5]);
+	// V-cycles by default, W-cycles visit the coarse levels more often
+	int gamma = (argc > 6) && (argv[6][0] == 'W') ? 2 : 1;
+	// Levels where a process would own fewer rows are agglomerated
+	int minRows = argc > 7 ? std::max(1, atoi(argv[7])) : 8;
+	// Write a checkpoint every checkpointEvery cycles, 0 for none
+	int checkpointEvery = argc > 8 ? std::max(0, atoi(argv[8])) : 0;
+
+	if((rows < numP) || (cols < 1)){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: Every process needs at least one row and the number of columns must be higher than 0"
+			          << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	// Measure the current time
+	double start = MPI::Wtime();
+
+	std::vector<Level> levels = buildLevels(rows, cols, minRows);
+	Level &fine = levels[0];
+
+	// The finest level has the same distribution as the Jacobi versions,
+	// every process reads its rows below the upper halo row
+	int cycles = readInput(inputFile, rows, cols, fine.first, 0, fine.myRows, cols, cols, &fine.u[cols]);
+	fine.tmp = fine.u;
+
+	float error = errThres+1.0;
+	float myError;
+
+	while(error > errThres){
+		cycle(levels, 0, gamma);
+
+		// The same error as in the Jacobi versions: the squared change
+		// of a plain sweep, which is kept
+		myError = smooth(fine, 1, 1.0f);
+		MPI::COMM_WORLD.Allreduce(&myError, &error, 1, MPI::FLOAT, MPI::SUM);
+		cycles++;
+
+		// The checkpoint is a matrix file that can be used as input
+		if(checkpointEvery && (cycles % checkpointEvery == 0)){
+			printOutput(outputFile+".ckpt", rows, cols, fine.first, 0, fine.myRows, cols, cols, &fine.u[cols], cycles);
+		}
+	}
+
+	// Measure the current time
+	double end = MPI::Wtime();
+
+	if(!myId){
+		int distributed = 0;
+		for(unsigned l=0; l<levels.size(); l++){
+			distributed += levels[l].comm == MPI::COMM_WORLD;
+		}
+		std::cout << "Multigrid " << (gamma == 1 ? "V" : "W") << "-cycles with " << numP << " processes: "
+		          << end-start << " seconds, " << cycles << " cycles, " << levels.size() << " levels ("
+		          << distributed << " distributed)" << std::endl;
+	}
+
+	// All processes write their rows to the output file
+	printOutput(outputFile, rows, cols, fine.first, 0, fine.myRows, cols, cols, &fine.u[cols], cycles);
+
+	// Terminate MPI
+	MPI::Finalize();
+	return 0;
+}
@@ -4,54 +4,44 @@
 #include <string.h>
 #include <chrono>
 
-void readInput(std::string file, int rows, int cols, float *data){
-
-	// Open the file pointer
-	/*FILE* fp = fopen(file.c_str(), "rb");
+#include "jacobi_stencil.hpp"
+#include "../include/binary_IO.hpp"
+
+// Reads the binary matrix file, for the file name "none" the matrix
+// is the checkerboard. Returns the iteration stored in the file,
+// a checkpoint resumes there.
+int readInput(std::string file, int rows, int cols, float *data){
+
+	matrix_header_t header;
+	if(file == "none"){
+		// checkerboard
+		for(int i=0; i<rows; i++)
+			for(int j=0; j<cols; j++)
+				data[i*cols+j] = (i/121+j/121) % 2;
+		return 0;
+	}
 
-	// Check if the file exists
-	if(fp == NULL){
-		std::cout << "ERROR: File " << file << " could not be opened" << std::endl;
+	if(!load_matrix_header(file, header) ||
+	   (header.rows != (uint64_t) rows) || (header.cols != (uint64_t) cols) ||
+	   !load_matrix_binary(data, header, file)){
+		std::cout << "ERROR: File " << file << " is not a " << rows << "x" << cols << " float matrix" << std::endl;
 		exit(1);
 	}
-
-	for(int i=0; i<rows*cols; i++){
-		if(!fscanf(fp, "%f", &data[i])){
-			std::cout << "ERROR: Not enough values in file " << file << std::endl;
-			exit(1);
-		}
-	}*/
-
-    // checkerboard
-    for(int i=0; i<rows; i++)
-        for(int j=0; j<cols; j++)
-            data[i*cols+j] = (i/121+j/121) % 2;
-
-    //fclose(fp);
+	return header.iteration;
 }
 
-void printOutput(std::string file, int rows, int cols, float *data){
+void printOutput(std::string file, int rows, int cols, float *data, int iteration){
 
-	FILE *fp = fopen(file.c_str(), "wb");
-	// Check if the file was opened
-	if(fp == NULL){
-		std::cout << "ERROR: Output file " << file << " could not be opened" << std::endl;
+	if(!dump_matrix_binary(data, rows, cols, file, iteration)){
+		std::cout << "ERROR: Output file " << file << " could not be written" << std::endl;
 		exit(1);
 	}
-
-    for(int i=0; i<rows; i++){
-        for(int j=0; j<cols; j++)
-        	fprintf(fp, "%lf ", data[i*cols+j]);
-        fprintf(fp, "\n");
-    }
-
-    fclose(fp);
 }
 
 int main (int argc, char *argv[]){
 	if(argc < 6){
 		std::cout << "ERROR: The syntax of the program is " << argv[0] 
-                          << " inputFile rows cols outputFile errThreshold"
+                          << " inputFile rows cols outputFile errThreshold [sweepsPerCheck tileRows checkpointEvery]"
 			  << std::endl;
 		exit(1);
 	}
@@ -61,15 +51,21 @@ int main (int argc, char *argv[]){
 	int cols = atoi(argv[3]);
 	std::string outputFile = argv[4];
 	float errThres = atof(argv[5]);
-
-	if((rows < 1) || (cols < 1)){
-		std::cout << "ERROR: The number of rows and columns must be higher than 0" << std::endl;
+	// Several sweeps per convergence check run with temporal blocking
+	int sweepsPerCheck = argc > 6 ? atoi(argv[6]) : 1;
+	int tileRows = argc > 7 ? atoi(argv[7]) : 32;
+	// Write a checkpoint every checkpointEvery iterations, 0 for none
+	int checkpointEvery = argc > 8 ? std::max(0, atoi(argv[8])) : 0;
+
+	if((rows < 1) || (cols < 1) || (sweepsPerCheck < 1) || (tileRows < 1)){
+		std::cout << "ERROR: The number of rows, columns, sweeps and tile rows must be higher than 0" << std::endl;
 		exit(1);
 	}
 
 	float *data = new float[rows*cols];
 	float *buff = new float[rows*cols];
-	readInput(inputFile, rows, cols, data);
+	int iterations = readInput(inputFile, rows, cols, data);
+	int lastCheckpoint = iterations;
 	memcpy(buff, data, rows*cols*sizeof(float));
 
 	// Measure the current time
@@ -79,32 +75,32 @@ int main (int argc, char *argv[]){
 	float error = errThres + 1.0;
 
 	while(error > errThres){
-		for(int i=1; i<rows-1; i++){
-			for(int j=1; j<cols-1; j++){
-				// calculate discrete laplacian by averaging 4-neighbourhood
-				buff[i*cols+j]= 0.25f*(data[(i+1)*cols+j]+data[i*cols+j-1]+data[i*cols+j+1]+data[(i-1)*cols+j]);
-			}
+		if(sweepsPerCheck == 1){
+			// The error of the sweep is accumulated while updating
+			error = jacobiSweep(data, buff, cols, 1, rows-1, 1, cols-1);
+
+			// The new matrix becomes the old one, no copy needed
+			std::swap(data, buff);
+		} else {
+			// The error of the last sweep decides
+			error = jacobiSweepsBlocked(data, buff, rows, cols, sweepsPerCheck, tileRows);
 		}
+		iterations += sweepsPerCheck;
 
-		// Determine the error
-		error = 0.0;
-		for(int i=1; i<rows-1; i++){
-			for(int j=1; j<cols-1; j++){
-                // determine difference between 'data' and 'buff' and add up error
-                error += (data[i*cols+j]-buff[i*cols+j])*(data[i*cols+j]-buff[i*cols+j]);
-			}
+		// The checkpoint is a matrix file that can be used as input
+		if(checkpointEvery && (iterations >= lastCheckpoint+checkpointEvery)){
+			printOutput(outputFile+".ckpt", rows, cols, data, iterations);
+			lastCheckpoint = iterations;
 		}
-
-		memcpy(data, buff, rows*cols*sizeof(float));
 	}
 
     end = std::chrono::system_clock::now();
     std::chrono::duration<float> elapsed_seconds = end-start;
 
 	std::cout << "Sequential Jacobi with dimensions " << rows << "x" << cols << " in " << elapsed_seconds.count()
-			<< " seconds" << std::endl;
+			<< " seconds, " << iterations << " iterations" << std::endl;
 
-	printOutput(outputFile, rows, cols, data);
+	printOutput(outputFile, rows, cols, data, iterations);
 
 	delete [] data;
 	delete [] buff;
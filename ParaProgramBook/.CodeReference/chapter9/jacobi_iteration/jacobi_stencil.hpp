@@ -0,0 +1,112 @@
+#ifndef JACOBI_STENCIL_HPP
+#define JACOBI_STENCIL_HPP
+
+#include <algorithm>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+// Updates the columns [c0,c1) of one row from the row above, the row
+// itself and the row below, and returns the squared change. The new values
+// are added in the order of the scalar loop, so vector and tail agree
+// exactly; the squared change is summed in 8 lanes and per row, so it
+// can differ from a single running sum in the last bits.
+// With a right hand side rhs (in units of the grid spacing squared) the
+// row is relaxed towards the solution of the Poisson equation, and a
+// weight below 1 damps the update (weighted Jacobi as smoother).
+inline float jacobiRow(const float *up, const float *mid, const float *down, float *out, int c0, int c1,
+                       const float *rhs=nullptr, float weight=1.0f){
+	float error = 0.0f;
+	int j = c0;
+
+#ifdef __AVX__
+	const __m256 quarter = _mm256_set1_ps(0.25f);
+	const __m256 omega = _mm256_set1_ps(weight);
+	__m256 errors = _mm256_setzero_ps();
+	for(; j+8 <= c1; j+=8){
+		const __m256 old = _mm256_loadu_ps(mid+j);
+		__m256 sum = _mm256_add_ps(_mm256_loadu_ps(down+j), _mm256_loadu_ps(mid+j-1));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(mid+j+1));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(up+j));
+		if(rhs){
+			sum = _mm256_add_ps(sum, _mm256_loadu_ps(rhs+j));
+		}
+		sum = _mm256_mul_ps(quarter, sum);
+		if(weight != 1.0f){
+			sum = _mm256_add_ps(old, _mm256_mul_ps(omega, _mm256_sub_ps(sum, old)));
+		}
+		_mm256_storeu_ps(out+j, sum);
+		const __m256 diff = _mm256_sub_ps(sum, old);
+		errors = _mm256_add_ps(errors, _mm256_mul_ps(diff, diff));
+	}
+	float lanes[8];
+	_mm256_storeu_ps(lanes, errors);
+	for(int k=0; k<8; k++){
+		error += lanes[k];
+	}
+#endif
+
+	for(; j<c1; j++){
+		// calculate discrete laplacian by averaging 4-neighbourhood
+		float sum = down[j]+mid[j-1]+mid[j+1]+up[j];
+		if(rhs){
+			sum += rhs[j];
+		}
+		out[j] = 0.25f*sum;
+		if(weight != 1.0f){
+			out[j] = mid[j]+weight*(out[j]-mid[j]);
+		}
+		error += (out[j]-mid[j])*(out[j]-mid[j]);
+	}
+	return error;
+}
+
+// One sweep over the rows [r0,r1) and columns [c0,c1) of arrays with
+// 'width' columns, rows are distributed over the OpenMP threads
+inline float jacobiSweep(const float *src, float *dst, int width, int r0, int r1, int c0, int c1,
+                         const float *rhs=nullptr, float weight=1.0f){
+	float error = 0.0f;
+	#pragma omp parallel for reduction(+:error) schedule(static)
+	for(int i=r0; i<r1; i++){
+		error += jacobiRow(&src[(i-1)*width], &src[i*width], &src[(i+1)*width], &dst[i*width], c0, c1,
+		                   rhs ? &rhs[i*width] : nullptr, weight);
+	}
+	return error;
+}
+
+// numSweeps sweeps over the interior of a rows x cols matrix with
+// temporal blocking: the rows are processed in tiles of tileRows rows
+// and every tile runs all sweeps while it is in cache. Sweep t of a tile
+// is shifted up by t rows (a wavefront in time), so everything it reads
+// was produced by sweep t-1 of this or the previous tile, and nothing
+// that a later tile still needs is overwritten in the two buffers.
+// Returns the squared change of the last sweep, src holds the result.
+inline float jacobiSweepsBlocked(float *&src, float *&dst, int rows, int cols, int numSweeps, int tileRows){
+	float error = 0.0f;
+
+	#pragma omp parallel
+	for(int lower=1; lower < rows-1+numSweeps-1; lower+=tileRows){
+		for(int t=0; t<numSweeps; t++){
+			const float *from = t%2 ? dst : src;
+			float *to = t%2 ? src : dst;
+			const int r0 = std::max(1, lower-t);
+			const int r1 = std::min(rows-1, lower+tileRows-t);
+
+			#pragma omp for reduction(+:error) schedule(static)
+			for(int i=r0; i<r1; i++){
+				const float change = jacobiRow(&from[(i-1)*cols], &from[i*cols], &from[(i+1)*cols], &to[i*cols], 1, cols-1);
+				if(t == numSweeps-1){
+					error += change;
+				}
+			}
+		}
+	}
+
+	if(numSweeps%2){
+		std::swap(src, dst);
+	}
+	return error;
+}
+
+#endif
@@ -0,0 +1,325 @@
+#ifndef DISTRIBUTED_GEMM_HPP
+#define DISTRIBUTED_GEMM_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include "mpi.h"
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+// Rows (or columns) of the block of coordinate 'coord' if 'length'
+// is split into 'parts' blocks, the first length%parts get one more
+inline void blockRange(int length, int parts, int coord, int &offset, int &size){
+	size = length/parts + (coord < length%parts);
+	offset = coord*(length/parts) + std::min(coord, length%parts);
+}
+
+// The block of blockRange that contains 'index'
+inline int blockOwner(int length, int parts, int index){
+	int big = length/parts+1;
+	int rem = length%parts;
+	if(index < big*rem){
+		return index/big;
+	}
+	return rem + (index-big*rem)/(length/parts);
+}
+
+// Splits [0,length) into panels of at most panelWidth that do not cross
+// the block borders of blockRange(length, p, ...) for every p in parts,
+// so that every panel has a single owner in each of these partitions
+inline void makePanels(int length, const std::vector<int> &parts, int panelWidth,
+                       std::vector<int> &panelStart, std::vector<int> &panelSize){
+	std::vector<int> cuts(1, length);
+	for(unsigned q=0; q<parts.size(); q++){
+		for(int p=0; p<parts[q]; p++){
+			int offset, size;
+			blockRange(length, parts[q], p, offset, size);
+			cuts.push_back(offset);
+		}
+	}
+	std::sort(cuts.begin(), cuts.end());
+	cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+	panelStart.clear();
+	panelSize.clear();
+	for(unsigned c=0; c+1<cuts.size(); c++){
+		for(int l=cuts[c]; l<cuts[c+1]; l+=panelWidth){
+			panelStart.push_back(l);
+			panelSize.push_back(std::min(panelWidth, cuts[c+1]-l));
+		}
+	}
+}
+
+// Register block of the local kernel (4 rows x 16 columns of C in eight
+// AVX registers) and cache blocks: a kc x nc panel of B stays in the L2
+// cache while mc x kc blocks of A pass through the L1 cache
+const int gemmMR = 4, gemmNR = 16;
+const int gemmMC = 64, gemmKC = 256, gemmNC = 1024;
+
+// C += A*B for small blocks without SIMD, also the edges of the kernel
+inline void edgeGemm(int m, int n, int k, const float *A, int lda, const float *B, int ldb, float *C, int ldc){
+	for(int i=0; i<m; i++){
+		for(int l=0; l<k; l++){
+			float a = A[i*lda+l];
+			for(int j=0; j<n; j++){
+				C[i*ldc+j] += a*B[l*ldb+j];
+			}
+		}
+	}
+}
+
+#ifdef __AVX__
+// C += A*B for a 4x16 block of C that stays in registers over all k
+inline void kernelGemm(int k, const float *A, int lda, const float *B, int ldb, float *C, int ldc){
+	__m256 c[gemmMR][2];
+	for(int r=0; r<gemmMR; r++){
+		c[r][0] = _mm256_loadu_ps(&C[r*ldc]);
+		c[r][1] = _mm256_loadu_ps(&C[r*ldc+8]);
+	}
+	for(int l=0; l<k; l++){
+		const __m256 b0 = _mm256_loadu_ps(&B[l*ldb]);
+		const __m256 b1 = _mm256_loadu_ps(&B[l*ldb+8]);
+		for(int r=0; r<gemmMR; r++){
+			const __m256 a = _mm256_broadcast_ss(&A[r*lda+l]);
+			c[r][0] = _mm256_add_ps(c[r][0], _mm256_mul_ps(a, b0));
+			c[r][1] = _mm256_add_ps(c[r][1], _mm256_mul_ps(a, b1));
+		}
+	}
+	for(int r=0; r<gemmMR; r++){
+		_mm256_storeu_ps(&C[r*ldc], c[r][0]);
+		_mm256_storeu_ps(&C[r*ldc+8], c[r][1]);
+	}
+}
+#endif
+
+// C += A*B for an mc x kc block of A and a kc x nc panel of B
+inline void blockGemm(int m, int n, int k, const float *A, int lda, const float *B, int ldb, float *C, int ldc){
+	int i = 0;
+#ifdef __AVX__
+	for(; i+gemmMR <= m; i+=gemmMR){
+		int j = 0;
+		for(; j+gemmNR <= n; j+=gemmNR){
+			kernelGemm(k, &A[i*lda], lda, &B[j], ldb, &C[i*ldc+j], ldc);
+		}
+		edgeGemm(gemmMR, n-j, k, &A[i*lda], lda, &B[j], ldb, &C[i*ldc+j], ldc);
+	}
+#endif
+	edgeGemm(m-i, n, k, &A[i*lda], lda, B, ldb, &C[i*ldc], ldc);
+}
+
+// C += A*B with A m x k, B k x n and C m x n, all row-major with the
+// leading dimensions lda, ldb and ldc
+inline void localGemm(int m, int n, int k, const float *A, int lda, const float *B, int ldb, float *C, int ldc){
+	for(int l0=0; l0<k; l0+=gemmKC){
+		int kb = std::min(gemmKC, k-l0);
+		for(int j0=0; j0<n; j0+=gemmNC){
+			int nb = std::min(gemmNC, n-j0);
+			for(int i0=0; i0<m; i0+=gemmMC){
+				int mb = std::min(gemmMC, m-i0);
+				blockGemm(mb, nb, kb, &A[i0*lda+l0], lda, &B[l0*ldb+j0], ldb, &C[i0*ldc+j0], ldc);
+			}
+		}
+	}
+}
+
+// C += A*B with pipelined SUMMA on the pr x pc process grid 'grid'.
+// Process (i,j) owns the blocks of the blockRange partitions: A(i,j) has
+// the rows i of m and the columns j of k, B(i,j) the rows i of k and the
+// columns j of n, and C(i,j) the rows i of m and the columns j of n. Any
+// grid shape and any sizes work. Panels of at most panelWidth columns of
+// A and rows of B are broadcast along the rows and the columns of the
+// grid, and the broadcasts of panel s+1 run while panel s is multiplied.
+// Returns the seconds spent waiting for panels.
+inline double summaPipelined(MPI::Cartcomm &grid, int m, int n, int k, const float *myA, const float *myB, float *myC,
+                             int panelWidth){
+	int dims[2], coords[2];
+	bool periods[2];
+	grid.Get_topo(2, dims, periods, coords);
+	const int pr = dims[0], pc = dims[1];
+	const int i = coords[0], j = coords[1];
+
+	const bool keepCols[2] = {false, true};
+	const bool keepRows[2] = {true, false};
+	MPI::Cartcomm rowComm = grid.Sub(keepCols);
+	MPI::Cartcomm colComm = grid.Sub(keepRows);
+
+	int rowOffset, myRows, colOffset, myCols, aOffset, myKA, bOffset, myKB;
+	blockRange(m, pr, i, rowOffset, myRows);
+	blockRange(n, pc, j, colOffset, myCols);
+	blockRange(k, pc, j, aOffset, myKA);
+	blockRange(k, pr, i, bOffset, myKB);
+
+	// A panel must lie within one block of A and one block of B
+	std::vector<int> parts(1, pc), panelStart, panelSize;
+	parts.push_back(pr);
+	makePanels(k, parts, panelWidth, panelStart, panelSize);
+	const int numPanels = panelStart.size();
+
+	// Two buffers for A and B: one is multiplied, the other is received
+	std::vector<float> panelA[2], panelB[2];
+	for(int b=0; b<2; b++){
+		panelA[b].resize(myRows*panelWidth);
+		panelB[b].resize(panelWidth*myCols);
+	}
+	MPI_Request request[2][2];
+
+	// The owners broadcast straight from their blocks, A with a strided
+	// type that matches the contiguous panels of the receivers
+	auto post = [&] (int s){
+		const int buf = s%2, kb = panelSize[s];
+		const int rootA = blockOwner(k, pc, panelStart[s]);
+		const int rootB = blockOwner(k, pr, panelStart[s]);
+
+		if(j == rootA){
+			MPI_Datatype columns;
+			MPI_Type_vector(myRows, kb, myKA, MPI_FLOAT, &columns);
+			MPI_Type_commit(&columns);
+			MPI_Ibcast(const_cast<float *>(&myA[panelStart[s]-aOffset]), 1, columns, rootA, rowComm,
+			           &request[buf][0]);
+			MPI_Type_free(&columns);
+		} else {
+			MPI_Ibcast(panelA[buf].data(), myRows*kb, MPI_FLOAT, rootA, rowComm, &request[buf][0]);
+		}
+
+		if(i == rootB){
+			MPI_Ibcast(const_cast<float *>(&myB[(panelStart[s]-bOffset)*myCols]), kb*myCols, MPI_FLOAT, rootB,
+			           colComm, &request[buf][1]);
+		} else {
+			MPI_Ibcast(panelB[buf].data(), kb*myCols, MPI_FLOAT, rootB, colComm, &request[buf][1]);
+		}
+	};
+
+	double waiting = 0.0;
+	post(0);
+	for(int s=0; s<numPanels; s++){
+		const int buf = s%2, kb = panelSize[s];
+		if(s+1 < numPanels){
+			post(s+1);
+		}
+
+		double start = MPI::Wtime();
+		MPI_Waitall(2, request[buf], MPI_STATUSES_IGNORE);
+		waiting += MPI::Wtime()-start;
+
+		const bool ownA = j == blockOwner(k, pc, panelStart[s]);
+		const bool ownB = i == blockOwner(k, pr, panelStart[s]);
+		const float *A = ownA ? &myA[panelStart[s]-aOffset] : panelA[buf].data();
+		const float *B = ownB ? &myB[(panelStart[s]-bOffset)*myCols] : panelB[buf].data();
+		localGemm(myRows, myCols, kb, A, ownA ? myKA : kb, B, myCols, myC, myCols);
+	}
+
+	rowComm.Free();
+	colComm.Free();
+	return waiting;
+}
+
+// C = A*B with Cannon's algorithm on a q x q x c grid whose first two
+// dimensions are periodic, c = 1 is the classic algorithm and c > 1 the
+// 2.5D variant. Layer 0 owns the blocks as in summaPipelined with pr =
+// pc = q, the other layers pass nullptr. The blocks are replicated and
+// skewed to all layers in one step, each layer performs its share of
+// the q shift steps, and C is summed onto layer 0. Replication trades
+// memory for c times fewer shifts per layer. Returns the seconds spent
+// in communication that is not overlapped.
+inline double cannon25D(MPI::Cartcomm &grid, int m, int n, int k, const float *myA, const float *myB, float *myC){
+	int dims[3], coords[3];
+	bool periods[3];
+	grid.Get_topo(3, dims, periods, coords);
+	const int q = dims[0], c = dims[2];
+	const int i = coords[0], j = coords[1], l = coords[2];
+
+	int rowOffset, myRows, colOffset, myCols;
+	blockRange(m, q, i, rowOffset, myRows);
+	blockRange(n, q, j, colOffset, myCols);
+	const int kMax = k/q + (k%q > 0);
+	auto kPart = [&] (int index){
+		int offset, size;
+		blockRange(k, q, (index%q+q)%q, offset, size);
+		return size;
+	};
+
+	// The shift steps [firstStep, firstStep+numSteps) of this layer
+	int firstStep, numSteps;
+	blockRange(q, c, l, firstStep, numSteps);
+
+	std::vector<float> a[2], b[2];
+	for(int buf=0; buf<2; buf++){
+		a[buf].resize(myRows*kMax);
+		b[buf].resize(kMax*myCols);
+	}
+	std::vector<float> partial;
+	float *C = myC;
+	if(l){
+		partial.assign(myRows*myCols, 0.0f);
+		C = partial.data();
+	} else {
+		std::fill(myC, myC+myRows*myCols, 0.0f);
+	}
+
+	double communication = 0.0;
+	double start = MPI::Wtime();
+
+	// Process (i,j,L) starts with A(i,i+j+s) and B(i+j+s,j) where s is the
+	// first step of layer L, all taken from layer 0
+	std::vector<MPI::Request> requests;
+	if(!l){
+		for(int L=0; L<c; L++){
+			int s, steps;
+			blockRange(q, c, L, s, steps);
+			const int toA[3] = {i, ((j-i-s)%q+q)%q, L};
+			const int toB[3] = {((i-j-s)%q+q)%q, j, L};
+			requests.push_back(grid.Isend(myA, myRows*kPart(j), MPI::FLOAT, grid.Get_cart_rank(toA), 0));
+			requests.push_back(grid.Isend(myB, kPart(i)*myCols, MPI::FLOAT, grid.Get_cart_rank(toB), 1));
+		}
+	}
+	const int first = (i+j+firstStep)%q;
+	const int fromA[3] = {i, first, 0};
+	const int fromB[3] = {first, j, 0};
+	requests.push_back(grid.Irecv(a[0].data(), myRows*kPart(first), MPI::FLOAT, grid.Get_cart_rank(fromA), 0));
+	requests.push_back(grid.Irecv(b[0].data(), kPart(first)*myCols, MPI::FLOAT, grid.Get_cart_rank(fromB), 1));
+	MPI::Request::Waitall(requests.size(), requests.data());
+	communication += MPI::Wtime()-start;
+
+	// A moves left and B moves up, the next blocks arrive while the
+	// current ones are multiplied
+	int leftSource, leftDest, upSource, upDest;
+	grid.Shift(1, -1, leftSource, leftDest);
+	grid.Shift(0, -1, upSource, upDest);
+
+	for(int s=0; s<numSteps; s++){
+		const int cur = s%2;
+		const int kb = kPart(i+j+firstStep+s);
+		MPI::Request shift[4];
+		int numShifts = 0;
+		if(s+1 < numSteps){
+			const int next = kPart(i+j+firstStep+s+1);
+			shift[numShifts++] = grid.Isend(a[cur].data(), myRows*kb, MPI::FLOAT, leftDest, 2);
+			shift[numShifts++] = grid.Irecv(a[1-cur].data(), myRows*next, MPI::FLOAT, leftSource, 2);
+			shift[numShifts++] = grid.Isend(b[cur].data(), kb*myCols, MPI::FLOAT, upDest, 3);
+			shift[numShifts++] = grid.Irecv(b[1-cur].data(), next*myCols, MPI::FLOAT, upSource, 3);
+		}
+
+		localGemm(myRows, myCols, kb, a[cur].data(), kb, b[cur].data(), myCols, C, myCols);
+
+		start = MPI::Wtime();
+		MPI::Request::Waitall(numShifts, shift);
+		communication += MPI::Wtime()-start;
+	}
+
+	// Sum the partial products of the layers onto layer 0
+	if(c > 1){
+		const bool keepDepth[3] = {false, false, true};
+		MPI::Cartcomm depth = grid.Sub(keepDepth);
+		start = MPI::Wtime();
+		MPI_Reduce(l ? C : MPI_IN_PLACE, C, myRows*myCols, MPI_FLOAT, MPI_SUM, 0, depth);
+		communication += MPI::Wtime()-start;
+		depth.Free();
+	}
+
+	return communication;
+}
+
+#endif
@@ -0,0 +1,175 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "mpi.h"
+#include "../include/mpi_binary_IO.hpp"
+#include "distributed_gemm.hpp"
+
+// The checkerboard block (myRows x myCols at rowOffset, colOffset)
+void readInput(int rowOffset, int colOffset, int myRows, int myCols, float *data){
+
+	for(int i=0; i<myRows; i++)
+		for(int j=0; j<myCols; j++)
+			data[i*myCols+j] = (rowOffset+i+colOffset+j) % 2;
+}
+
+// All processes write their blocks to the binary matrix file at once,
+// processes without a block take part with an empty one
+void printOutput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+                 float *data){
+
+	if(!write_matrix_block(file, MPI_COMM_WORLD, data, rows, cols, rowOffset, colOffset, myRows, myCols, myCols)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: Output file " << file << " could not be written" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+}
+
+// Number of wrong entries in a block of the product of two checkerboards:
+// C(i,j) counts the l < k with i+l and l+j odd, none if i+j is odd
+int checkOutput(int k, int rowOffset, int colOffset, int myRows, int myCols, const float *data){
+
+	int errors = 0;
+	for(int i=0; i<myRows; i++){
+		for(int j=0; j<myCols; j++){
+			int row = rowOffset+i, col = colOffset+j;
+			float expected = (row+col)%2 ? 0 : (k+1-(row+1)%2)/2;
+			errors += data[i*myCols+j] != expected;
+		}
+	}
+	return errors;
+}
+
+int main (int argc, char *argv[]){
+	// Initialize MPI
+	MPI::Init(argc,argv);
+
+	// Get the number of processes
+	int numP=MPI::COMM_WORLD.Get_size();
+
+	// Get the ID of the process
+	int myId=MPI::COMM_WORLD.Get_rank();
+
+	std::string algorithm = argc > 1 ? argv[1] : "";
+	if((argc < 5) || ((algorithm != "summa") && (algorithm != "cannon") && (algorithm != "2.5D"))){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: The syntax of the program is ./gemm summa|cannon|2.5D m k n "
+			          << "[panelWidth (summa) | layers (2.5D)] [outputFile]" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	int m = atoi(argv[2]);
+	int k = atoi(argv[3]);
+	int n = atoi(argv[4]);
+	int param = argc > 5 ? atoi(argv[5]) : (algorithm == "summa" ? 256 : 2);
+	std::string outputFile = argc > 6 ? argv[6] : "";
+
+	if((m < 1) || (n < 1) || (k < 1) || (param < 1)){
+		// Only the first process prints the output message
+		if(!myId)
+			std::cout << "ERROR: 'm', 'k', 'n' and the panel width or layers must be higher than 0" << std::endl;
+
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	// SUMMA takes any grid, Cannon needs a square q x q grid and 2.5D a
+	// q x q x c grid whose depth c divides q, so that every layer performs
+	// q/c of the q shift steps (in particular c <= q, i.e. c^3 <= P)
+	int layers = algorithm == "2.5D" ? param : 1;
+	int gridDim = lround(sqrt(numP/layers));
+	bool square = !(numP%layers) && (gridDim*gridDim*layers == numP);
+	if((algorithm == "cannon") && !square){
+		// Only the first process prints the output message
+		if(!myId)
+			std::cout << "ERROR: cannon needs a square number of processes" << std::endl;
+
+		MPI::COMM_WORLD.Abort(1);
+	}
+	if((algorithm == "2.5D") && (!square || (gridDim%layers))){
+		// Only the first process prints the output message
+		if(!myId)
+			std::cout << "ERROR: 2.5D with c layers needs c*q*q processes where c divides q" << std::endl;
+
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	MPI::Cartcomm grid;
+	int gridRows, gridCols, coords[3] = {0, 0, 0};
+	if(algorithm == "summa"){
+		int dims[2] = {0, 0};
+		bool periods[2] = {false, false};
+		MPI::Compute_dims(numP, 2, dims);
+		grid = MPI::COMM_WORLD.Create_cart(2, dims, periods, false);
+		grid.Get_coords(grid.Get_rank(), 2, coords);
+		gridRows = dims[0];
+		gridCols = dims[1];
+	} else {
+		int dims[3] = {gridDim, gridDim, layers};
+		bool periods[3] = {true, true, false};
+		grid = MPI::COMM_WORLD.Create_cart(3, dims, periods, false);
+		grid.Get_coords(grid.Get_rank(), 3, coords);
+		gridRows = gridCols = gridDim;
+	}
+
+	// The processes of layer 0 own the blocks of A, B and C
+	bool owner = !coords[2];
+	int rowOffset, myRows, colOffset, myCols, aOffset, myKA, bOffset, myKB;
+	blockRange(m, gridRows, coords[0], rowOffset, myRows);
+	blockRange(n, gridCols, coords[1], colOffset, myCols);
+	blockRange(k, gridCols, coords[1], aOffset, myKA);
+	blockRange(k, gridRows, coords[0], bOffset, myKB);
+	if(!owner){
+		myRows = myCols = myKA = myKB = 0;
+	}
+
+	float *myA = new float[myRows*myKA];
+	float *myB = new float[myKB*myCols];
+	float *myC = new float[myRows*myCols]();
+	readInput(rowOffset, aOffset, myRows, myKA, myA);
+	readInput(bOffset, colOffset, myKB, myCols, myB);
+
+	// Measure the current time
+	MPI::COMM_WORLD.Barrier();
+	double start = MPI::Wtime();
+
+	double myWaiting;
+	if(algorithm == "summa"){
+		myWaiting = summaPipelined(grid, m, n, k, myA, myB, myC, param);
+	} else {
+		myWaiting = cannon25D(grid, m, n, k, owner ? myA : nullptr, owner ? myB : nullptr, myC);
+	}
+
+	// Measure the current time
+	double end = MPI::Wtime();
+
+	int myErrors = checkOutput(k, rowOffset, colOffset, myRows, myCols, myC), errors;
+	double waiting;
+	MPI::COMM_WORLD.Reduce(&myErrors, &errors, 1, MPI::INT, MPI::SUM, 0);
+	MPI::COMM_WORLD.Reduce(&myWaiting, &waiting, 1, MPI::DOUBLE, MPI::MAX, 0);
+
+	if(!myId){
+		std::cout << algorithm << " on a " << gridRows << "x" << gridCols << "x" << layers << " grid: "
+		          << end-start << " seconds, " << 2.0*m*n*k/(end-start)*1E-9 << " GFLOP/s, "
+		          << waiting << " seconds communication not overlapped, " << errors << " errors" << std::endl;
+	}
+
+	if(outputFile != ""){
+		printOutput(outputFile, m, n, rowOffset, colOffset, myRows, myCols, myC);
+	}
+
+	delete [] myA;
+	delete [] myB;
+	delete [] myC;
+	grid.Free();
+
+	// Terminate MPI
+	MPI::Finalize();
+	return 0;
+}
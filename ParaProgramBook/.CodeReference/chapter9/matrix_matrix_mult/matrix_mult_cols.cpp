@@ -2,49 +2,48 @@
 #include <stdio.h>
 #include <iostream>
 #include <string.h>
+#include <algorithm>
 
 #include "mpi.h"
-
-void readInput(std::string file, int rows, int cols, float *data){
-
-	// Open the file pointer
-	/*FILE* fp = fopen(file.c_str(), "rb");
-
-	// Check if the file exists
-	if(fp == NULL){
-		std::cout << "ERROR: File " << file << " could not be opened" << std::endl;
-		MPI::COMM_WORLD.Abort(1);
+#include "../include/mpi_binary_IO.hpp"
+
+// The processes of comm read the block (myRows x myCols at rowOffset,
+// colOffset) of the binary matrix file that they need. For the file name
+// "none" the block is filled with the checkerboard.
+void readInput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+               float *data, MPI_Comm comm=MPI_COMM_WORLD){
+
+	matrix_header_t header;
+	if(file == "none"){
+		// checkerboard
+		for(int i=0; i<myRows; i++)
+			for(int j=0; j<myCols; j++)
+				data[i*myCols+j] = (rowOffset+i+colOffset+j) % 2;
+		return;
 	}
 
-	for(int i=0; i<rows*cols; i++){
-		if(!fscanf(fp, "%f", &data[i])){
-			std::cout << "ERROR: Not enough values in file " << file << std::endl;
-			MPI::COMM_WORLD.Abort(1);
+	if(!read_matrix_header(file, comm, header) ||
+	   (header.rows != (uint64_t) rows) || (header.cols != (uint64_t) cols) ||
+	   !read_matrix_block(file, comm, data, header, rowOffset, colOffset, myRows, myCols, myCols)){
+		int rank;
+		MPI_Comm_rank(comm, &rank);
+		if(!rank){
+			std::cout << "ERROR: File " << file << " is not a " << rows << "x" << cols << " float matrix" << std::endl;
 		}
-	}*/
-
-    // checkerboard
-    for(int i=0; i<rows; i++)
-        for(int j=0; j<cols; j++)
-            data[i*cols+j] = (i+j) % 2;
+		MPI::COMM_WORLD.Abort(1);
+	}
 }
 
-void printOutput(std::string file, int rows, int cols, float *data){
+// All processes write their blocks to the binary matrix file at once
+void printOutput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+                 float *data){
 
-	FILE *fp = fopen(file.c_str(), "wb");
-	// Check if the file was opened
-	if(fp == NULL){
-		std::cout << "ERROR: Output file " << file << " could not be opened" << std::endl;
+	if(!write_matrix_block(file, MPI_COMM_WORLD, data, rows, cols, rowOffset, colOffset, myRows, myCols, myCols)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: Output file " << file << " could not be written" << std::endl;
+		}
 		MPI::COMM_WORLD.Abort(1);
 	}
-
-    for(int i=0; i<rows; i++){
-        for(int j=0; j<cols; j++)
-        	fprintf(fp, "%lf ", data[i*cols+j]);
-        fprintf(fp, "\n");
-    }
-
-    fclose(fp);
 }
 
 int main (int argc, char *argv[]){
@@ -81,83 +80,53 @@ int main (int argc, char *argv[]){
 		MPI::COMM_WORLD.Abort(1);
 	}
 
-	// A is replicated in all the processes
-	float *A = new float[m*k];
-	float *B;
-	float *C;
+	// The computation is divided by columns
+	int blockCols = n/numP;
+	int myCols = blockCols;
 
-	// Only one process reads the data from the files and broadcasts the data
-	if(!myId){
-		readInput(inputFileA, m, k, A);
-		B = new float[k*n];
-		readInput(inputFileB, k, n, B);
-		C = new float[m*n];
+	// For the cases that 'cols' is not multiple of numP
+	if(myId < n%numP){
+		myCols++;
 	}
+	int firstCol = myId*blockCols + std::min(myId, n%numP);
 
-	// The computation is divided by rows
-	int blockCols = n/numP;
+	// Arrays for the chunk of data to work, A is replicated in all the processes
+	float *A = new float[m*k];
+	float *myB = new float[k*myCols];
+	float *myC = new float[m*myCols];
 
-	// Create the datatype column
-	MPI::Datatype colTypeB = MPI::FLOAT.Create_vector(k, blockCols, n);
-	colTypeB.Commit();
-	MPI::Datatype colTypeC = MPI::FLOAT.Create_vector(m, blockCols, n);
-	colTypeC.Commit();
+	// Every process reads its columns of B, only the process 0 reads A
+	readInput(inputFileB, k, n, 0, firstCol, k, myCols, myB);
+	if(!myId){
+		readInput(inputFileA, m, k, 0, 0, m, k, A, MPI_COMM_SELF);
+	}
 
 	// Measure the current time
+	MPI::COMM_WORLD.Barrier();
 	double start = MPI::Wtime();
 
-	// Arrays for the chunk of data to work
-	float *myB = new float[k*blockCols];
-	float *myC = new float[m*blockCols];
-
 	// Broadcast the input matrix A
 	MPI::COMM_WORLD.Bcast(A, m*k, MPI::FLOAT, 0);
 
-	MPI::Status status;
-	MPI::Request req;
-
-	// Scatter the input matrix B
-	if(!myId){
-		for(int i=numP-1; i>=0; i--){
-			req = MPI::COMM_WORLD.Isend(&B[i*blockCols], 1, colTypeB, i, 0);
-		}
-	}
-
-	MPI::COMM_WORLD.Recv(myB, k*blockCols, MPI::FLOAT, 0, 0, status);
-
 	// The multiplication of the submatrices
 	for(int i=0; i<m; i++){
-		for(int j=0; j<blockCols; j++){
-			myC[i*blockCols+j] = 0.0;
+		for(int j=0; j<myCols; j++){
+			myC[i*myCols+j] = 0.0;
 			for(int l=0; l<k; l++){
-				myC[i*blockCols+j] += A[i*k+l]*myB[l*blockCols+j];
+				myC[i*myCols+j] += A[i*k+l]*myB[l*myCols+j];
 			}
 		}
 	}
 
-	// Only process 0 writes
-	// Gather the final matrix to the memory of process 0
-	req = MPI::COMM_WORLD.Isend(myC, m*blockCols, MPI::FLOAT, 0, 0);
-	if(!myId){
-		for(int i=numP-1; i>=0; i--){
-			MPI::COMM_WORLD.Recv(&C[i*blockCols], 1, colTypeC, i, 0, status);
-		}
-	}
-
 	// Measure the current time
 	double end = MPI::Wtime();
 
-	colTypeB.Free();
-	colTypeC.Free();
-
 	if(!myId){
     	std::cout << "Time with " << numP << " processes: " << end-start << " seconds" << std::endl;
-    	printOutput(outputFile, m, n, C);
-		delete [] B;
-		delete [] C;
 	}
 
-	MPI::COMM_WORLD.Barrier();
+	// All processes write their columns of C
+	printOutput(outputFile, m, n, 0, firstCol, m, myCols, myC);
 
 	delete [] A;
 	delete [] myB;
@@ -2,49 +2,48 @@
 #include <stdio.h>
 #include <iostream>
 #include <string.h>
+#include <algorithm>
 
 #include "mpi.h"
-
-void readInput(std::string file, int rows, int cols, float *data){
-
-	// Open the file pointer
-	/*FILE* fp = fopen(file.c_str(), "rb");
-
-	// Check if the file exists
-	if(fp == NULL){
-		std::cout << "ERROR: File " << file << " could not be opened" << std::endl;
-		MPI::COMM_WORLD.Abort(1);
+#include "../include/mpi_binary_IO.hpp"
+
+// The processes of comm read the block (myRows x myCols at rowOffset,
+// colOffset) of the binary matrix file that they need. For the file name
+// "none" the block is filled with the checkerboard.
+void readInput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+               float *data, MPI_Comm comm=MPI_COMM_WORLD){
+
+	matrix_header_t header;
+	if(file == "none"){
+		// checkerboard
+		for(int i=0; i<myRows; i++)
+			for(int j=0; j<myCols; j++)
+				data[i*myCols+j] = (rowOffset+i+colOffset+j) % 2;
+		return;
 	}
 
-	for(int i=0; i<rows*cols; i++){
-		if(!fscanf(fp, "%f", &data[i])){
-			std::cout << "ERROR: Not enough values in file " << file << std::endl;
-			MPI::COMM_WORLD.Abort(1);
+	if(!read_matrix_header(file, comm, header) ||
+	   (header.rows != (uint64_t) rows) || (header.cols != (uint64_t) cols) ||
+	   !read_matrix_block(file, comm, data, header, rowOffset, colOffset, myRows, myCols, myCols)){
+		int rank;
+		MPI_Comm_rank(comm, &rank);
+		if(!rank){
+			std::cout << "ERROR: File " << file << " is not a " << rows << "x" << cols << " float matrix" << std::endl;
 		}
-	}*/
-
-    // checkerboard
-    for(int i=0; i<rows; i++)
-        for(int j=0; j<cols; j++)
-            data[i*cols+j] = (i+j) % 2;
+		MPI::COMM_WORLD.Abort(1);
+	}
 }
 
-void printOutput(std::string file, int rows, int cols, float *data){
+// All processes write their blocks to the binary matrix file at once
+void printOutput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+                 float *data){
 
-	FILE *fp = fopen(file.c_str(), "wb");
-	// Check if the file was opened
-	if(fp == NULL){
-		std::cout << "ERROR: Output file " << file << " could not be opened" << std::endl;
+	if(!write_matrix_block(file, MPI_COMM_WORLD, data, rows, cols, rowOffset, colOffset, myRows, myCols, myCols)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: Output file " << file << " could not be written" << std::endl;
+		}
 		MPI::COMM_WORLD.Abort(1);
 	}
-
-    for(int i=0; i<rows; i++){
-        for(int j=0; j<cols; j++)
-        	fprintf(fp, "%lf ", data[i*cols+j]);
-        fprintf(fp, "\n");
-    }
-
-    fclose(fp);
 }
 
 int main (int argc, char *argv[]){
@@ -81,19 +80,6 @@ int main (int argc, char *argv[]){
 		MPI::COMM_WORLD.Abort(1);
 	}
 
-	float *A;
-	// B is replicated in all the processes
-	float *B = new float[k*n];
-	float *C;
-
-	// Only one process reads the data from the files and broadcasts the data
-	if(!myId){
-		A = new float[m*k];
-		readInput(inputFileA, m, k, A);
-		readInput(inputFileB, k, n, B);
-		C = new float[m*n];
-	}
-
 	// The computation is divided by rows
 	int blockRows = m/numP;
 	int myRows = blockRows;
@@ -102,39 +88,23 @@ int main (int argc, char *argv[]){
 	if(myId < m%numP){
 		myRows++;
 	}
+	int firstRow = myId*blockRows + std::min(myId, m%numP);
 
-	// Measure the current time
-	double start = MPI::Wtime();
-
-	// Arrays for the chunk of data to work
+	// Arrays for the chunk of data to work, B is replicated in all the processes
 	float *myA = new float[myRows*k];
+	float *B = new float[k*n];
 	float *myC = new float[myRows*n];
 
-	// The process 0 must specify how many rows are sent to each process
-	int *sendCounts;
-	int *displs;
+	// Every process reads its rows of A, only the process 0 reads B
+	readInput(inputFileA, m, k, firstRow, 0, myRows, k, myA);
 	if(!myId){
-		sendCounts = new int[numP];
-		displs = new int[numP];
-
-		displs[0] = 0;
-
-		for(int i=0; i<numP; i++){
-
-			if(i>0){
-				displs[i] = displs[i-1]+sendCounts[i-1];
-			}
-
-			if(i < m%numP){
-				sendCounts[i] = (blockRows+1)*k;
-			} else {
-				sendCounts[i] = blockRows*k;
-			}
-		}
+		readInput(inputFileB, k, n, 0, 0, k, n, B, MPI_COMM_SELF);
 	}
 
-	// Scatter the input matrix A
-	MPI::COMM_WORLD.Scatterv(A, sendCounts, displs, MPI::FLOAT, myA, myRows*k, MPI::FLOAT, 0);
+	// Measure the current time
+	MPI::COMM_WORLD.Barrier();
+	double start = MPI::Wtime();
+
 	// Broadcast the input matrix B
 	MPI::COMM_WORLD.Bcast(B, k*n, MPI::FLOAT, 0);
 
@@ -148,34 +118,16 @@ int main (int argc, char *argv[]){
 		}
 	}
 
-	// Only process 0 writes
-	// Gather the final matrix to the memory of process 0
-	if(!myId){
-		for(int i=0; i<numP; i++){
-
-			if(i>0){
-				displs[i] = displs[i-1]+sendCounts[i-1];
-			}
-
-			if(i < m%numP){
-				sendCounts[i] = (blockRows+1)*n;
-			} else {
-				sendCounts[i] = blockRows*n;
-			}
-		}
-	}
-	MPI::COMM_WORLD.Gatherv(myC, myRows*n, MPI::FLOAT, C, sendCounts, displs, MPI::FLOAT, 0);
-
 	// Measure the current time
 	double end = MPI::Wtime();
 
 	if(!myId){
     	std::cout << "Time with " << numP << " processes: " << end-start << " seconds" << std::endl;
-    	printOutput(outputFile, m, n, C);
-		delete [] A;
-		delete [] C;
 	}
 
+	// All processes write their rows of C
+	printOutput(outputFile, m, n, firstRow, 0, myRows, n, myC);
+
 	delete [] B;
 	delete [] myA;
 	delete [] myC;
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <string.h>
+#include <algorithm>
+
+#include "mpi.h"
+#include "../include/mpi_binary_IO.hpp"
+#include "../include/mpi_hybrid.hpp"
+#include "../../chapter5/thread_pool/threadpool.hpp"
+
+// Every process reads the block (myRows x myCols at rowOffset, colOffset)
+// of the binary matrix file that it needs. For the file name "none"
+// the block is filled with the checkerboard.
+void readInput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+               float *data){
+
+	matrix_header_t header;
+	if(file == "none"){
+		// checkerboard
+		for(int i=0; i<myRows; i++)
+			for(int j=0; j<myCols; j++)
+				data[i*myCols+j] = (rowOffset+i+colOffset+j) % 2;
+		return;
+	}
+
+	if(!read_matrix_header(file, MPI_COMM_WORLD, header) ||
+	   (header.rows != (uint64_t) rows) || (header.cols != (uint64_t) cols) ||
+	   !read_matrix_block(file, MPI_COMM_WORLD, data, header, rowOffset, colOffset, myRows, myCols, myCols)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: File " << file << " is not a " << rows << "x" << cols << " float matrix" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+}
+
+// All processes write their blocks to the binary matrix file at once
+void printOutput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+                 float *data){
+
+	if(!write_matrix_block(file, MPI_COMM_WORLD, data, rows, cols, rowOffset, colOffset, myRows, myCols, myCols)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: Output file " << file << " could not be written" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+}
+
+int main (int argc, char *argv[]){
+	// Initialize MPI, only the main thread calls MPI
+	init_mpi_threads(argc, argv, MPI_THREAD_FUNNELED);
+
+	// Get the number of processes
+	int numP=MPI::COMM_WORLD.Get_size();
+
+	// Get the ID of the process
+	int myId=MPI::COMM_WORLD.Get_rank();
+
+	if(argc < 7){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: The syntax of the program is ./matrix_mult_rows_hybrid inputMatA inputMatB outputMat "
+			          << "m k n [threads]" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	std::string inputFileA = argv[1];
+	std::string inputFileB = argv[2];
+	std::string outputFile = argv[3];
+	int m = atoi(argv[4]);
+	int k = atoi(argv[5]);
+	int n = atoi(argv[6]);
+	// By default one thread per core the process is bound to
+	int numThreads = argc > 7 ? atoi(argv[7]) : cpu_topology().num_cores();
+
+	if((m < 1) || (n < 1) || (k<1) || (numThreads < 1)){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: 'm', 'k', 'n' and 'threads' must be higher than 0" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	// The computation is divided by rows
+	int blockRows = m/numP;
+	int myRows = blockRows;
+
+	// For the cases that 'rows' is not multiple of numP
+	if(myId < m%numP){
+		myRows++;
+	}
+	int firstRow = myId*blockRows + std::min(myId, m%numP);
+
+	// Arrays for the chunk of data to work. B is replicated once per
+	// process and shared by its threads, not once per core
+	float *myA = new float[myRows*k];
+	float *B = new float[k*n];
+	float *myC = new float[myRows*n];
+
+	// Every process reads its rows of A and the whole B
+	readInput(inputFileA, m, k, firstRow, 0, myRows, k, myA);
+	readInput(inputFileB, k, n, 0, 0, k, n, B);
+
+	// Measure the current time
+	MPI::COMM_WORLD.Barrier();
+	double start = MPI::Wtime();
+
+	// The rows of the process are split over the threads: the first task
+	// enqueues the others and multiplies its own rows. The threads never
+	// call MPI, the main thread waits for them
+	auto multiply = [&] (int t){
+		int first = t*(myRows/numThreads) + std::min(t, myRows%numThreads);
+		int last = first + myRows/numThreads + (t < myRows%numThreads);
+		for(int i=first; i<last; i++){
+			for(int j=0; j<n; j++){
+				myC[i*n+j] = 0.0;
+				for(int l=0; l<k; l++){
+					myC[i*n+j] += myA[i*k+l]*B[l*n+j];
+				}
+			}
+		}
+	};
+
+	ThreadPool pool(numThreads);
+	pool.enqueue([&] (){
+		for(int t=1; t<numThreads; t++){
+			pool.enqueue(multiply, t);
+		}
+		multiply(0);
+	});
+	pool.wait_and_stop();
+
+	// Measure the current time
+	double end = MPI::Wtime();
+
+	// The peak memory of the busiest node, replicating B per core instead
+	// of per process shows up here
+	unsigned long long myNodeMemory = node_peak_memory_bytes(MPI_COMM_WORLD), nodeMemory;
+	MPI_Reduce(&myNodeMemory, &nodeMemory, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+
+	if(!myId){
+		std::cout << "Time with " << numP << " processes and " << numThreads << " threads per process: "
+		          << end-start << " seconds, peak memory per node " << (nodeMemory >> 20) << " MB" << std::endl;
+	}
+
+	// All processes write their rows of C
+	printOutput(outputFile, m, n, firstRow, 0, myRows, n, myC);
+
+	delete [] B;
+	delete [] myA;
+	delete [] myC;
+
+	// Terminate MPI
+	MPI::Finalize();
+	return 0;
+}
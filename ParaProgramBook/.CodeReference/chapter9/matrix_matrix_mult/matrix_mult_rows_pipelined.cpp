@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <string.h>
+#include <algorithm>
+
+#include "mpi.h"
+#include "../include/mpi_binary_IO.hpp"
+#include "distributed_gemm.hpp"
+
+// Every process reads the block (myRows x myCols at rowOffset, colOffset)
+// of the binary matrix file that it needs. For the file name "none"
+// the block is filled with the checkerboard.
+void readInput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+               float *data){
+
+	matrix_header_t header;
+	if(file == "none"){
+		// checkerboard
+		for(int i=0; i<myRows; i++)
+			for(int j=0; j<myCols; j++)
+				data[i*myCols+j] = (rowOffset+i+colOffset+j) % 2;
+		return;
+	}
+
+	if(!read_matrix_header(file, MPI_COMM_WORLD, header) ||
+	   (header.rows != (uint64_t) rows) || (header.cols != (uint64_t) cols) ||
+	   !read_matrix_block(file, MPI_COMM_WORLD, data, header, rowOffset, colOffset, myRows, myCols, myCols)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: File " << file << " is not a " << rows << "x" << cols << " float matrix" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+}
+
+// All processes write their blocks to the binary matrix file at once
+void printOutput(std::string file, int rows, int cols, int rowOffset, int colOffset, int myRows, int myCols,
+                 float *data){
+
+	if(!write_matrix_block(file, MPI_COMM_WORLD, data, rows, cols, rowOffset, colOffset, myRows, myCols, myCols)){
+		if(!MPI::COMM_WORLD.Get_rank()){
+			std::cout << "ERROR: Output file " << file << " could not be written" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+}
+
+int main (int argc, char *argv[]){
+	// Initialize MPI
+	MPI::Init(argc,argv);
+
+	// Get the number of processes
+	int numP=MPI::COMM_WORLD.Get_size();
+
+	// Get the ID of the process
+	int myId=MPI::COMM_WORLD.Get_rank();
+
+	if(argc < 7){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: The syntax of the program is ./matrix_mult_rows_pipelined inputMatA inputMatB outputMat "
+			          << "m k n [panelRows]" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	std::string inputFileA = argv[1];
+	std::string inputFileB = argv[2];
+	std::string outputFile = argv[3];
+	int m = atoi(argv[4]);
+	int k = atoi(argv[5]);
+	int n = atoi(argv[6]);
+	int panelRows = argc > 7 ? atoi(argv[7]) : 64;
+
+	if((m < 1) || (n < 1) || (k<1) || (panelRows < 1)){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: 'm', 'k', 'n' and 'panelRows' must be higher than 0" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	// The computation is divided by rows. B is not replicated: every
+	// process only keeps its block of rows of B
+	int firstRow, myRows, firstK, myK;
+	blockRange(m, numP, myId, firstRow, myRows);
+	blockRange(k, numP, myId, firstK, myK);
+
+	float *myA = new float[myRows*k];
+	float *myB = new float[myK*n];
+	float *myC = new float[myRows*n]();
+
+	// Every process reads its rows of A and its rows of B
+	readInput(inputFileA, m, k, firstRow, 0, myRows, k, myA);
+	readInput(inputFileB, k, n, firstK, 0, myK, n, myB);
+
+	// B is streamed in panels of at most panelRows rows that lie within
+	// the block of one process, two buffers: one is multiplied while the
+	// broadcast of the next panel fills the other
+	std::vector<int> parts(1, numP), panelStart, panelSize;
+	makePanels(k, parts, panelRows, panelStart, panelSize);
+	const int numPanels = panelStart.size();
+	float *panel[2] = {new float[panelRows*n], new float[panelRows*n]};
+	MPI_Request request[2];
+
+	// The owner broadcasts straight from its block
+	auto post = [&] (int s){
+		const int root = blockOwner(k, numP, panelStart[s]);
+		float *buff = myId == root ? &myB[(panelStart[s]-firstK)*n] : panel[s%2];
+		MPI_Ibcast(buff, panelSize[s]*n, MPI_FLOAT, root, MPI_COMM_WORLD, &request[s%2]);
+	};
+
+	// Measure the current time
+	MPI::COMM_WORLD.Barrier();
+	double start = MPI::Wtime();
+
+	double myWaiting = 0.0, myCompute = 0.0;
+	post(0);
+	for(int s=0; s<numPanels; s++){
+		if(s+1 < numPanels){
+			post(s+1);
+		}
+
+		double t = MPI::Wtime();
+		MPI_Wait(&request[s%2], MPI_STATUS_IGNORE);
+		myWaiting += MPI::Wtime()-t;
+
+		// The panel multiplies its columns of the rows of A
+		t = MPI::Wtime();
+		const bool own = myId == blockOwner(k, numP, panelStart[s]);
+		const float *B = own ? &myB[(panelStart[s]-firstK)*n] : panel[s%2];
+		localGemm(myRows, n, panelSize[s], &myA[panelStart[s]], k, B, n, myC, n);
+		myCompute += MPI::Wtime()-t;
+	}
+
+	// Measure the current time
+	double end = MPI::Wtime();
+
+	// The overlap efficiency is the fraction of the time of the loop that
+	// is spent computing, 1 if all the broadcasts are hidden
+	double waiting, compute;
+	MPI::COMM_WORLD.Reduce(&myWaiting, &waiting, 1, MPI::DOUBLE, MPI::SUM, 0);
+	MPI::COMM_WORLD.Reduce(&myCompute, &compute, 1, MPI::DOUBLE, MPI::SUM, 0);
+
+	if(!myId){
+		std::cout << "Time with " << numP << " processes: " << end-start << " seconds, " << numPanels << " panels, "
+		          << waiting/numP << " seconds waiting, overlap efficiency " << compute/(compute+waiting) << std::endl;
+	}
+
+	// All processes write their rows of C
+	printOutput(outputFile, m, n, firstRow, 0, myRows, n, myC);
+
+	delete [] myA;
+	delete [] myB;
+	delete [] myC;
+	delete [] panel[0];
+	delete [] panel[1];
+
+	// Terminate MPI
+	MPI::Finalize();
+	return 0;
+}
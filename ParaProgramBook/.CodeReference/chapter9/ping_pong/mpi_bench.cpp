@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <algorithm>
+
+#include "mpi.h"
+
+// Fewer repetitions for the larger messages, at least a few for 16MB
+int repetitions(int size){
+	return std::max(4, std::min(1000, (1 << 25)/std::max(size, 1)));
+}
+
+// Seconds per call of 'op', the maximum over all processes. One call
+// before the measurement warms up the buffers and the connections
+template <typename op_t>
+double measure(int reps, op_t op){
+	op();
+	MPI::COMM_WORLD.Barrier();
+	double start = MPI::Wtime();
+	for(int r=0; r<reps; r++){
+		op();
+	}
+	double myTime = (MPI::Wtime()-start)/reps, time;
+	MPI::COMM_WORLD.Allreduce(&myTime, &time, 1, MPI::DOUBLE, MPI::MAX);
+	return time;
+}
+
+// Column of the table: microseconds, or MB/s if 'bandwidth' bytes
+// were moved in 'time'. Tests that do not apply to a size print "-"
+void printCell(double time, double bandwidth=0.0){
+	std::cout << std::setw(11);
+	if(time < 0.0){
+		std::cout << "-";
+	} else if(bandwidth > 0.0){
+		std::cout << bandwidth/time*1E-6;
+	} else {
+		std::cout << time*1E6;
+	}
+}
+
+int main (int argc, char *argv[]){
+	// Initialize MPI
+	MPI::Init(argc,argv);
+
+	// Get the number of processes
+	int numP=MPI::COMM_WORLD.Get_size();
+
+	// Get the ID of the process
+	int myId=MPI::COMM_WORLD.Get_rank();
+
+	int maxSize = argc > 1 ? atoi(argv[1]) : 16 << 20;
+
+	if((numP < 2) || (maxSize < 1)){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: The syntax of the program is mpirun -np P " << argv[0]
+			          << " [maxBytes], with P > 1 and maxBytes > 0" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	// The strided tests use every second float of twice the size, their
+	// packed form only needs the size itself. Together 5*maxSize bytes
+	// per process, i.e. 80MB for the default of 16MB
+	MPI::Datatype largest = MPI::FLOAT.Create_vector(std::max(maxSize/4, 1), 1, 2);
+	largest.Commit();
+	int maxPackSize = largest.Pack_size(1, MPI::COMM_WORLD);
+	largest.Free();
+
+	char *sendBuff = new char[2*maxSize];
+	char *recvBuff = new char[2*maxSize];
+	char *packBuff = new char[maxPackSize];
+	memset(sendBuff, 1, 2*maxSize);
+	memset(recvBuff, 0, 2*maxSize);
+
+	int next = (myId+1)%numP, prev = (myId+numP-1)%numP;
+
+	if(!myId){
+		char version[MPI_MAX_LIBRARY_VERSION_STRING];
+		int length;
+		MPI_Get_library_version(version, &length);
+		std::string library(version, length);
+		std::cout << "# " << library.substr(0, library.find('\n')) << std::endl;
+		std::cout << "# " << numP << " processes, point to point between processes 0 and 1" << std::endl;
+		std::cout << "# Times in microseconds per operation, bandwidths in MB/s" << std::endl;
+		std::cout << std::setw(10) << "bytes" << std::setw(11) << "pingpong" << std::setw(11) << "MB/s"
+		          << std::setw(11) << "bidir MB/s" << std::setw(11) << "ring" << std::setw(11) << "ring Isend"
+		          << std::setw(11) << "Bcast" << std::setw(11) << "Allreduce" << std::setw(11) << "Alltoall"
+		          << std::setw(11) << "vector" << std::setw(11) << "packed" << std::endl;
+		std::cout << std::fixed << std::setprecision(2);
+	}
+
+	for(int size=1; size<=maxSize; size*=2){
+		int reps = repetitions(size);
+
+		// Ping-pong: half the round trip is the latency of one message
+		double pingPong = measure(reps, [&] (){
+			if(myId == 0){
+				MPI::COMM_WORLD.Send(sendBuff, size, MPI::BYTE, 1, 0);
+				MPI::COMM_WORLD.Recv(recvBuff, size, MPI::BYTE, 1, 0);
+			} else if(myId == 1){
+				MPI::COMM_WORLD.Recv(recvBuff, size, MPI::BYTE, 0, 0);
+				MPI::COMM_WORLD.Send(sendBuff, size, MPI::BYTE, 0, 0);
+			}
+		})/2;
+
+		// Bidirectional: both directions at once, 2*size bytes moved
+		double bidirectional = measure(reps, [&] (){
+			if(myId < 2){
+				MPI::Request requests[2];
+				requests[0] = MPI::COMM_WORLD.Irecv(recvBuff, size, MPI::BYTE, 1-myId, 0);
+				requests[1] = MPI::COMM_WORLD.Isend(sendBuff, size, MPI::BYTE, 1-myId, 0);
+				MPI::Request::Waitall(2, requests);
+			}
+		});
+
+		// Ring: every process sends to the next and receives from the
+		// previous, with the blocking Sendrecv and with Irecv/Isend
+		double ring = measure(reps, [&] (){
+			MPI::COMM_WORLD.Sendrecv(sendBuff, size, MPI::BYTE, next, 0, recvBuff, size, MPI::BYTE, prev, 0);
+		});
+		double ringNonblock = measure(reps, [&] (){
+			MPI::Request requests[2];
+			requests[0] = MPI::COMM_WORLD.Irecv(recvBuff, size, MPI::BYTE, prev, 0);
+			requests[1] = MPI::COMM_WORLD.Isend(sendBuff, size, MPI::BYTE, next, 0);
+			MPI::Request::Waitall(2, requests);
+		});
+
+		// Collectives: Bcast of size bytes, Allreduce of size/4 floats and
+		// Alltoall with size bytes sent by each process in total
+		double bcast = measure(reps, [&] (){
+			MPI::COMM_WORLD.Bcast(sendBuff, size, MPI::BYTE, 0);
+		});
+
+		int floats = size/4;
+		double allreduce = -1.0;
+		if(floats){
+			allreduce = measure(reps, [&] (){
+				MPI::COMM_WORLD.Allreduce(sendBuff, recvBuff, floats, MPI::FLOAT, MPI::SUM);
+			});
+		}
+
+		int block = size/numP;
+		double alltoall = -1.0;
+		if(block){
+			alltoall = measure(reps, [&] (){
+				MPI::COMM_WORLD.Alltoall(sendBuff, block, MPI::BYTE, recvBuff, block, MPI::BYTE);
+			});
+		}
+
+		// Strided data (every second float) sent as a derived datatype and
+		// packed into a contiguous buffer with MPI_Pack, as ping-pongs
+		double vector = -1.0, packed = -1.0;
+		if(floats){
+			MPI::Datatype strided = MPI::FLOAT.Create_vector(floats, 1, 2);
+			strided.Commit();
+			int packSize = strided.Pack_size(1, MPI::COMM_WORLD);
+
+			vector = measure(reps, [&] (){
+				if(myId == 0){
+					MPI::COMM_WORLD.Send(sendBuff, 1, strided, 1, 0);
+					MPI::COMM_WORLD.Recv(recvBuff, 1, strided, 1, 0);
+				} else if(myId == 1){
+					MPI::COMM_WORLD.Recv(recvBuff, 1, strided, 0, 0);
+					MPI::COMM_WORLD.Send(sendBuff, 1, strided, 0, 0);
+				}
+			})/2;
+
+			packed = measure(reps, [&] (){
+				int position = 0;
+				if(myId == 0){
+					strided.Pack(sendBuff, 1, packBuff, packSize, position, MPI::COMM_WORLD);
+					MPI::COMM_WORLD.Send(packBuff, position, MPI::PACKED, 1, 0);
+					MPI::COMM_WORLD.Recv(packBuff, packSize, MPI::PACKED, 1, 0);
+					position = 0;
+					strided.Unpack(packBuff, packSize, recvBuff, 1, position, MPI::COMM_WORLD);
+				} else if(myId == 1){
+					MPI::COMM_WORLD.Recv(packBuff, packSize, MPI::PACKED, 0, 0);
+					strided.Unpack(packBuff, packSize, recvBuff, 1, position, MPI::COMM_WORLD);
+					position = 0;
+					strided.Pack(sendBuff, 1, packBuff, packSize, position, MPI::COMM_WORLD);
+					MPI::COMM_WORLD.Send(packBuff, position, MPI::PACKED, 0, 0);
+				}
+			})/2;
+
+			strided.Free();
+		}
+
+		if(!myId){
+			std::cout << std::setw(10) << size;
+			printCell(pingPong);
+			printCell(pingPong, size);
+			printCell(bidirectional, 2.0*size);
+			printCell(ring);
+			printCell(ringNonblock);
+			printCell(bcast);
+			printCell(allreduce);
+			printCell(alltoall);
+			printCell(vector);
+			printCell(packed);
+			std::cout << std::endl;
+		}
+	}
+
+	delete [] sendBuff;
+	delete [] recvBuff;
+	delete [] packBuff;
+
+	// Terminate MPI
+	MPI::Finalize();
+	return 0;
+}
@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <omp.h>
+
+#include "mpi.h"
+
+// Bit-packed wheel: the multiples of 2, 3 and 5 are never stored. Byte b
+// holds the 8 numbers 30*b+wheel[i] (bit i) that are coprime to 30, so a
+// byte covers 30 numbers
+const int wheel[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+
+// Bit of every residue modulo 30 that is coprime to 30
+int wheelBit(int r){
+	return std::find(wheel, wheel+8, r)-wheel;
+}
+
+// Bytes [offset, offset+size) of the block 'part' of the 'length' bytes
+// split into 'parts' blocks, the first length%parts get one more
+void blockRange(uint64_t length, uint64_t parts, uint64_t part, uint64_t &offset, uint64_t &size){
+	size = length/parts + (part < length%parts);
+	offset = part*(length/parts) + std::min(part, length%parts);
+}
+
+// Sieves the bytes [first, first+size) in segments of segBytes and counts
+// the primes in them up to n, the multiples of every base prime p are
+// crossed off with stride p bytes for each of the 8 residues of the
+// cofactor. The next multiple of each pair is kept across segments
+uint64_t sieveRange(uint64_t first, uint64_t size, uint64_t n, const std::vector<unsigned> &basePrimes,
+                    int segBytes){
+	const int numBase = basePrimes.size();
+	std::vector<uint64_t> next(8*numBase);
+	std::vector<unsigned char> mask(8*numBase);
+
+	// The first multiple p*q >= max(p*p, 30*first) for every residue of q
+	for(int j=0; j<numBase; j++){
+		const uint64_t p = basePrimes[j];
+		const uint64_t q0 = std::max(p, (30*first+p-1)/p);
+		for(int i=0; i<8; i++){
+			const uint64_t q = q0 + (wheel[i]+30-q0%30)%30;
+			next[8*j+i] = p*q/30;
+			mask[8*j+i] = ~(1 << wheelBit(p*q%30));
+		}
+	}
+
+	std::vector<unsigned char> segment(segBytes+8);
+	const uint64_t lastByte = n/30;
+	uint64_t count = 0;
+
+	for(uint64_t lo=first; lo<first+size; lo+=segBytes){
+		const uint64_t len = std::min<uint64_t>(segBytes, first+size-lo);
+		unsigned char *seg = segment.data();
+		memset(seg, 0xff, len);
+
+		for(int j=0; j<numBase; j++){
+			const uint64_t p = basePrimes[j];
+			// The smallest multiple is p*p, the later primes start beyond
+			if(p*p/30 >= lo+len){
+				break;
+			}
+			for(int i=0; i<8; i++){
+				uint64_t b = next[8*j+i]-lo;
+				const unsigned char m = mask[8*j+i];
+				for(; b<len; b+=p){
+					seg[b] &= m;
+				}
+				next[8*j+i] = lo+b;
+			}
+		}
+
+		// 1 is not prime and the numbers above n are not counted
+		if(!lo){
+			seg[0] &= ~1;
+		}
+		if(lo+len-1 == lastByte){
+			for(int i=0; i<8; i++){
+				if(uint64_t(wheel[i]) > n%30){
+					seg[len-1] &= ~(1 << i);
+				}
+			}
+		}
+
+		// Count 8 bytes at once, the padding is zero
+		memset(seg+len, 0, 8);
+		for(uint64_t b=0; b<len; b+=8){
+			uint64_t word;
+			memcpy(&word, seg+b, 8);
+			count += __builtin_popcountll(word);
+		}
+	}
+	return count;
+}
+
+int main (int argc, char *argv[]){
+	// Initialize MPI, only the master thread of each process calls MPI
+	MPI::Init_thread(argc, argv, MPI::THREAD_FUNNELED);
+
+	// Get the number of processes
+	int numP=MPI::COMM_WORLD.Get_size();
+
+	// Get the ID of the process
+	int myId=MPI::COMM_WORLD.Get_rank();
+
+	if(argc < 2){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: The syntax of the program is "
+			          << argv[0] << " n [segmentKB]" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	// The segments are L2 cache sized by default
+	long long n = atoll(argv[1]);
+	int segBytes = 1024*(argc > 2 ? atoi(argv[2]) : 256);
+
+	if((n < 1) || (segBytes < 1)){
+		// Only the first process prints the output message
+		if(!myId){
+			std::cout << "ERROR: The parameters 'n' and 'segmentKB' must be higher than 0" << std::endl;
+		}
+		MPI::COMM_WORLD.Abort(1);
+	}
+
+	// Barrier to synchronize the processes before measuring time
+	MPI::COMM_WORLD.Barrier();
+
+	// Measure the current time
+	double start = MPI::Wtime();
+
+	// The first process finds the base primes up to sqrt(n) without 2, 3
+	// and 5, and sends them to all processes
+	std::vector<unsigned> basePrimes;
+	int numBase;
+	if(!myId){
+		unsigned root = sqrt((double) n);
+		while((uint64_t) root*root > (uint64_t) n) root--;
+		while((uint64_t) (root+1)*(root+1) <= (uint64_t) n) root++;
+
+		std::vector<char> composite(root+1, 0);
+		for(unsigned i=2; i<=root; i++){
+			if(!composite[i]){
+				if(i > 5){
+					basePrimes.push_back(i);
+				}
+				for(uint64_t j=(uint64_t) i*i; j<=root; j+=i){
+					composite[j] = 1;
+				}
+			}
+		}
+		numBase = basePrimes.size();
+	}
+	MPI::COMM_WORLD.Bcast(&numBase, 1, MPI::INT, 0);
+	basePrimes.resize(numBase);
+	MPI::COMM_WORLD.Bcast(basePrimes.data(), numBase, MPI::UNSIGNED, 0);
+
+	// Each process sieves a block of the bytes, and each of its threads a
+	// block of that. The crossings are spread evenly over the numbers, so
+	// the block distribution is balanced
+	uint64_t myFirst, mySize;
+	blockRange(n/30+1, numP, myId, myFirst, mySize);
+
+	long long myCount = 0;
+	int numThreads = omp_get_max_threads();
+	#pragma omp parallel reduction(+:myCount)
+	{
+		uint64_t first, size;
+		blockRange(mySize, omp_get_num_threads(), omp_get_thread_num(), first, size);
+		myCount += sieveRange(myFirst+first, size, n, basePrimes, segBytes);
+	}
+
+	// 2, 3 and 5 are not in the wheel
+	if(!myId){
+		myCount += (n >= 2) + (n >= 3) + (n >= 5);
+	}
+
+	// Reduce the partial counts into 'total' in the process 0
+	long long total;
+	MPI::COMM_WORLD.Reduce(&myCount, &total, 1, MPI::LONG_LONG, MPI::SUM, 0);
+
+	// Measure the current time
+	double end = MPI::Wtime();
+
+	if(!myId){
+		std::cout << total << " primes between 1 and " << n << std::endl;
+		std::cout << "Time with " << numP << " processes and " << numThreads << " threads per process: "
+		          << end-start << " seconds" << std::endl;
+	}
+
+	// Terminate MPI
+	MPI::Finalize();
+	return 0;
+}
@@ -0,0 +1,275 @@
+#ifndef ALIGNED_BUFFER_HPP
+#define ALIGNED_BUFFER_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "hpc_helpers.hpp"  // no_init_t, SDIV
+
+// how the pages of a buffer are backed
+enum class page_mode_t {
+    normal,       // regular 4 KiB pages
+    transparent,  // 2 MiB aligned and madvise(MADV_HUGEPAGE)
+    huge          // explicit hugetlbfs pages (MAP_HUGETLB), falls
+                  // back to transparent if none are reserved
+};
+
+// where the pages end up on a NUMA machine
+enum class touch_mode_t {
+    none,         // first touch by whoever writes first
+    parallel,     // first touch by num_threads threads in blocks,
+                  // i.e. the same partition a block-parallel kernel uses
+    interleave    // round-robin over all online NUMA nodes
+};
+
+// the online NUMA nodes as a bit mask, parsed from sysfs ("0-1,4")
+inline std::vector<unsigned long> numa_online_mask() {
+
+    std::vector<unsigned long> mask(1, 1UL);  // node 0 if unknown
+    std::ifstream ifile("/sys/devices/system/node/online");
+    std::string list;
+    if (!(ifile >> list))
+        return mask;
+
+    mask.assign(1, 0UL);
+    const uint64_t bits = 8*sizeof(unsigned long);
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        const std::string range = list.substr(pos, end-pos);
+        const size_t dash = range.find('-');
+        const uint64_t lower = std::stoul(range.substr(0, dash));
+        const uint64_t upper = dash == std::string::npos ? lower :
+                               std::stoul(range.substr(dash+1));
+        for (uint64_t node = lower; node <= upper; node++) {
+            if (node/bits >= mask.size())
+                mask.resize(node/bits+1, 0UL);
+            mask[node/bits] |= 1UL << (node%bits);
+        }
+        pos = end+1;
+    }
+
+    return mask;
+}
+
+// a non-owning view of length consecutive elements
+template <
+    typename value_t,
+    typename index_t=uint64_t>
+class buffer_view_t {
+
+private:
+    value_t * ptr;
+    index_t length;
+
+public:
+    typedef no_init_t<value_t> value_type;
+
+    buffer_view_t(value_t * ptr_, index_t length_) :
+        ptr(ptr_), length(length_) {}
+
+    value_t * data() const { return ptr; }
+    index_t size() const { return length; }
+    value_t * begin() const { return ptr; }
+    value_t * end() const { return ptr+length; }
+    value_t& operator[](index_t index) const { return ptr[index]; }
+
+    buffer_view_t view(index_t lower, index_t count) const {
+        return buffer_view_t(ptr+lower, count);
+    }
+};
+
+// Contiguous storage of length uninitialized elements, aligned to
+// alignment bytes (at least a page), optionally backed by huge pages
+// and placed on the NUMA nodes by parallel first touch or interleaving.
+// Elements behave like std::vector<no_init_t<value_t>>: nothing is
+// initialized, data() hands out a plain value_t* for the kernels.
+template <
+    typename value_t,
+    uint64_t alignment=64>
+class aligned_buffer_t {
+
+    static_assert(alignment && !(alignment & (alignment-1)),
+                  "alignment must be a power of two");
+
+private:
+
+    value_t * ptr;
+    uint64_t length;
+    void * mapping;
+    uint64_t mapping_bytes;
+
+    static uint64_t page_size() {
+        return sysconf(_SC_PAGESIZE);
+    }
+
+    // maps size bytes at a multiple of align: reserves what the mapping
+    // does not guarantee on top (it starts at a multiple of granule)
+    // and trims the rest, MAP_FAILED if the mapping fails
+    static void * map_aligned(uint64_t size, uint64_t align,
+                              uint64_t granule, int flags) {
+
+        const uint64_t reserve = size+(align > granule ? align-granule : 0);
+        void * raw = mmap(nullptr, reserve, PROT_READ | PROT_WRITE,
+                          flags, -1, 0);
+        if (raw == MAP_FAILED)
+            return MAP_FAILED;
+
+        const uint64_t base = reinterpret_cast<uint64_t>(raw);
+        const uint64_t first = SDIV(base, align)*align;
+        if (first > base)
+            munmap(raw, first-base);
+        if (base+reserve > first+size)
+            munmap(reinterpret_cast<void*>(first+size), base+reserve-first-size);
+
+        return reinterpret_cast<void*>(first);
+    }
+
+    void allocate(page_mode_t pages) {
+
+        const uint64_t huge_page = 1UL << 21;
+        const uint64_t bytes = std::max<uint64_t>(1, length*sizeof(value_t));
+
+        #ifdef MAP_HUGETLB
+        if (pages == page_mode_t::huge) {
+            mapping_bytes = SDIV(bytes, huge_page)*huge_page;
+            mapping = map_aligned(mapping_bytes, std::max(alignment, huge_page),
+                                  huge_page, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB);
+            if (mapping != MAP_FAILED) {
+                ptr = static_cast<value_t*>(mapping);
+                return;
+            }
+            pages = page_mode_t::transparent;
+        }
+        #endif
+
+        // alignments beyond a page are honoured by over-allocating
+        uint64_t align = std::max(alignment, page_size());
+        if (pages == page_mode_t::transparent)
+            align = std::max(align, huge_page);
+
+        mapping_bytes = SDIV(bytes, page_size())*page_size();
+        mapping = map_aligned(mapping_bytes, align, page_size(),
+                              MAP_PRIVATE | MAP_ANONYMOUS);
+        if (mapping == MAP_FAILED)
+            throw std::bad_alloc();
+        ptr = static_cast<value_t*>(mapping);
+
+        #ifdef MADV_HUGEPAGE
+        if (pages == page_mode_t::transparent)
+            madvise(mapping, mapping_bytes, MADV_HUGEPAGE);
+        #endif
+    }
+
+    void place(touch_mode_t touch, uint64_t num_threads) {
+
+        if (touch == touch_mode_t::interleave) {
+            #ifdef SYS_mbind
+            // MPOL_INTERLEAVE from <linux/mempolicy.h>, the raw system
+            // call avoids linking libnuma; ignored on single node systems
+            const int mpol_interleave = 3;
+            auto mask = numa_online_mask();
+            syscall(SYS_mbind, mapping, mapping_bytes, mpol_interleave,
+                    mask.data(), 8*sizeof(unsigned long)*mask.size()+1, 0);
+            #endif
+            return;
+        }
+
+        if (touch != touch_mode_t::parallel)
+            return;
+
+        // every thread writes one byte per page of its block of elements,
+        // threads beyond the number of pages would have nothing to touch
+        const uint64_t num_pages = SDIV(std::max<uint64_t>(1, length*sizeof(value_t)),
+                                        page_size());
+        num_threads = std::max<uint64_t>(1, std::min(num_threads, num_pages));
+        const uint64_t chunk = SDIV(length, num_threads);
+        const uint64_t step = page_size();
+
+        auto first_touch = [&] (const uint64_t& id) -> void {
+            const uint64_t lower = std::min(id*chunk, length);
+            const uint64_t upper = std::min(lower+chunk, length);
+            char * begin = reinterpret_cast<char*>(ptr+lower);
+            char * end   = reinterpret_cast<char*>(ptr+upper);
+            for (char * byte = begin; byte < end; byte += step)
+                *reinterpret_cast<volatile char*>(byte) = 0;
+        };
+
+        std::vector<std::thread> threads;
+        for (uint64_t id = 0; id < num_threads; id++)
+            threads.emplace_back(first_touch, id);
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+public:
+    typedef no_init_t<value_t> value_type;
+
+    aligned_buffer_t(
+        uint64_t length_,
+        page_mode_t pages=page_mode_t::transparent,
+        touch_mode_t touch=touch_mode_t::parallel,
+        uint64_t num_threads=std::thread::hardware_concurrency()) :
+        ptr(nullptr), length(length_),
+        mapping(MAP_FAILED), mapping_bytes(0) {
+
+        allocate(pages);
+        place(touch, num_threads);
+    }
+
+    ~aligned_buffer_t() {
+        release();
+    }
+
+    // give the memory back before the end of the scope
+    void release() {
+        if (mapping != MAP_FAILED)
+            munmap(mapping, mapping_bytes);
+        mapping = MAP_FAILED;
+        ptr = nullptr;
+        length = 0;
+    }
+
+    // move only
+    aligned_buffer_t(const aligned_buffer_t&) = delete;
+    aligned_buffer_t& operator=(const aligned_buffer_t&) = delete;
+
+    aligned_buffer_t(aligned_buffer_t&& other) noexcept :
+        ptr(other.ptr), length(other.length),
+        mapping(other.mapping), mapping_bytes(other.mapping_bytes) {
+        other.mapping = MAP_FAILED;
+        other.ptr = nullptr;
+        other.length = 0;
+    }
+
+    value_t * data() const { return ptr; }
+    uint64_t size() const { return length; }
+    value_t * begin() const { return ptr; }
+    value_t * end() const { return ptr+length; }
+
+    value_type& operator[](uint64_t index) const {
+        return reinterpret_cast<value_type*>(ptr)[index];
+    }
+
+    buffer_view_t<value_t> view() const {
+        return buffer_view_t<value_t>(ptr, length);
+    }
+
+    buffer_view_t<value_t> view(uint64_t lower, uint64_t count) const {
+        return buffer_view_t<value_t>(ptr+lower, count);
+    }
+};
+
+#endif
@@ -0,0 +1,475 @@
+#ifndef ATOMIC_RMW_HPP
+#define ATOMIC_RMW_HPP
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "cache_aligned.hpp"  // padded_array_t, FALSE_SHARING_WRITE
+
+// the alignment of data written by different threads
+#define CACHE_LINE_SIZE (destructive_interference_size)
+
+// tell the core we are spinning (frees the pipeline for the sibling
+// hyperthread and reduces the power and the memory order violations)
+inline void cpu_relax() {
+    #if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+    #elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+    #else
+        std::this_thread::yield();
+    #endif
+}
+
+// randomized exponential backoff: after each failed attempt we wait for
+// a random number of pauses below a limit that doubles up to max_spins,
+// beyond that we additionally yield the time slice
+class backoff_t {
+
+private:
+    uint32_t limit;
+    uint32_t min_spins;
+    uint32_t max_spins;
+    uint64_t state;
+
+public:
+    backoff_t(
+        uint32_t min_spins_=4,
+        uint32_t max_spins_=1024) :
+        // at least one spin, the limit is the modulus below
+        limit(std::max<uint32_t>(1, min_spins_)),
+        min_spins(limit),
+        max_spins(std::max(limit, max_spins_)),
+        state(reinterpret_cast<uint64_t>(this) | 1) {}
+
+    void operator()() {
+
+        // xorshift64, the threads must not back off in lock step
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        const uint32_t spins = 1 + state % limit;
+        for (uint32_t spin = 0; spin < spins; spin++)
+            cpu_relax();
+
+        if (limit < max_spins)
+            limit = std::min(2*limit, max_spins);
+        else
+            std::this_thread::yield();
+    }
+
+    void reset() {
+        limit = min_spins;
+    }
+};
+
+// test and test-and-set lock: waiters spin on a shared read
+// and only issue the exchange once the lock looks free
+class spinlock_t {
+
+private:
+    std::atomic<bool> locked;
+
+public:
+    spinlock_t() : locked(false) {}
+
+    void lock() {
+        backoff_t backoff;
+        while (locked.exchange(true, std::memory_order_acquire))
+            while (locked.load(std::memory_order_relaxed))
+                backoff();
+    }
+
+    bool try_lock() {
+        return !locked.load(std::memory_order_relaxed) &&
+               !locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() {
+        locked.store(false, std::memory_order_release);
+    }
+};
+
+// ticket lock: fair first in first out order, every waiter
+// draws a ticket and spins until it is served
+class ticket_lock_t {
+
+private:
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> next;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> serving;
+
+public:
+    ticket_lock_t() : next(0), serving(0) {}
+
+    void lock() {
+        const uint32_t ticket = next.fetch_add(1, std::memory_order_relaxed);
+        uint32_t rounds = 0;
+        while (true) {
+            const uint32_t current = serving.load(std::memory_order_acquire);
+            if (current == ticket)
+                return;
+            // wait proportionally to our position in the queue and give
+            // the time slice away if the holder seems to be descheduled
+            for (uint32_t spin = 0; spin < 16*(ticket-current); spin++)
+                cpu_relax();
+            if (++rounds % 64 == 0)
+                std::this_thread::yield();
+        }
+    }
+
+    void unlock() {
+        serving.store(serving.load(std::memory_order_relaxed)+1,
+                      std::memory_order_release);
+    }
+};
+
+// binary_atomic from arbitrary_atomics.cpp with backoff after
+// every failed compare and swap
+template <
+    typename atomc_t,
+    typename value_t,
+    typename funct_t,
+    typename predc_t>
+value_t binary_atomic_backoff(
+    atomc_t& atomic,
+    const value_t& operand,
+    funct_t function,
+    predc_t predicate) {
+
+    value_t expect = atomic.load(std::memory_order_relaxed);
+    value_t target;
+    backoff_t backoff;
+
+    while (true) {
+        target = function(expect, operand);
+
+        if (!predicate(target))
+            return expect;
+
+        if (atomic.compare_exchange_weak(expect, target))
+            return expect;
+
+        backoff();
+    }
+}
+
+// ternary_atomic from universal_atomics.cpp with backoff after
+// every failed compare and swap
+template <
+    typename atomc_t,
+    typename value_t,
+    typename funcp_t,
+    typename funcn_t,
+    typename predc_t>
+value_t ternary_atomic_backoff(
+    atomc_t& atomic,
+    const value_t& operand,
+    funcp_t pos_function,
+    funcn_t neg_function,
+    predc_t predicate) {
+
+    value_t expect = atomic.load(std::memory_order_relaxed);
+    value_t target;
+    backoff_t backoff;
+
+    while (true) {
+        if (predicate(expect, operand))
+            target = pos_function(expect, operand);
+        else
+            target = neg_function(expect, operand);
+
+        if (atomic.compare_exchange_weak(expect, target))
+            return expect;
+
+        backoff();
+    }
+}
+
+// Flat combining: every thread publishes its operand in a private slot,
+// whoever grabs the lock applies all published operations in one go and
+// writes the results back. The shared value is only touched by a single
+// combiner, i.e. the cache line stops bouncing between the cores.
+// The combiner commits its batch with one compare and swap, so combining
+// threads may be mixed with threads that update the value directly.
+template <
+    typename value_t,
+    typename funct_t>
+class flat_combiner_t {
+
+private:
+    // slot states
+    static constexpr uint32_t empty = 0;
+    static constexpr uint32_t pending = 1;
+    static constexpr uint32_t done = 2;
+
+    struct slot_t {
+        std::atomic<uint32_t> state;
+        value_t operand;
+        value_t result;
+        slot_t() : state(empty) {}
+    };
+
+    std::atomic<value_t>& value;
+    funct_t function;
+    padded_array_t<slot_t> slots;
+    std::vector<uint64_t> batch;
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> locked;
+
+    void combine() {
+
+        batch.clear();
+        for (uint64_t id = 0; id < slots.size(); id++)
+            if (slots[id].state.load(std::memory_order_acquire) == pending)
+                batch.push_back(id);
+
+        value_t expect = value.load(std::memory_order_relaxed);
+        value_t target;
+
+        // apply the batch locally and commit it at once
+        do {
+            target = expect;
+            for (const auto& id : batch) {
+                slots[id].result = target;
+                target = function(target, slots[id].operand);
+            }
+        } while (!value.compare_exchange_weak(expect, target));
+
+        for (const auto& id : batch)
+            slots[id].state.store(done, std::memory_order_release);
+    }
+
+public:
+    flat_combiner_t(
+        std::atomic<value_t>& value_,
+        funct_t function_,
+        uint64_t num_slots) :
+        value(value_),
+        function(function_),
+        slots(num_slots),
+        locked(false) {
+        batch.reserve(num_slots);
+    }
+
+    // apply function(value, operand) on behalf of thread id and
+    // return the previous value like fetch_add does
+    value_t apply(
+        const value_t& operand,
+        uint64_t id) {
+
+        slot_t& slot = slots[id];
+        FALSE_SHARING_WRITE(&slot.operand);
+        slot.operand = operand;
+        slot.state.store(pending, std::memory_order_release);
+        backoff_t backoff;
+
+        while (true) {
+            if (slot.state.load(std::memory_order_acquire) == done) {
+                slot.state.store(empty, std::memory_order_relaxed);
+                return slot.result;
+            }
+
+            // test and test-and-set: only read the lock while it is taken
+            if (!locked.load(std::memory_order_relaxed) &&
+                !locked.exchange(true, std::memory_order_acquire)) {
+                combine();
+                locked.store(false, std::memory_order_release);
+            } else {
+                backoff();
+            }
+        }
+    }
+
+    uint64_t num_slots() const {
+        return slots.size();
+    }
+};
+
+// Per-thread partial results for a commutative and associative function
+// with neutral element identity: every thread updates its own cache line
+// without any synchronization cost and load() merges the shards lazily.
+// There is no previous value to return, so this is for reductions only.
+template <
+    typename value_t,
+    typename funct_t>
+class sharded_accumulator_t {
+
+private:
+    funct_t function;
+    value_t identity;
+    padded_array_t<std::atomic<value_t>> shards;
+
+public:
+    sharded_accumulator_t(
+        funct_t function_,
+        const value_t& identity_,
+        uint64_t num_shards) :
+        function(function_),
+        identity(identity_),
+        shards(num_shards) {
+        reset();
+    }
+
+    // a single writer per shard: relaxed load and store suffice
+    void accumulate(
+        const value_t& operand,
+        uint64_t id) {
+
+        auto& shard = shards[id];
+        FALSE_SHARING_WRITE(&shard);
+        shard.store(function(shard.load(std::memory_order_relaxed), operand),
+                    std::memory_order_relaxed);
+    }
+
+    // the merged value, exact once the writers are joined
+    value_t load() const {
+        value_t result = identity;
+        for (uint64_t id = 0; id < shards.size(); id++)
+            result = function(result,
+                              shards[id].load(std::memory_order_relaxed));
+        return result;
+    }
+
+    void reset() {
+        for (uint64_t id = 0; id < shards.size(); id++)
+            shards[id].store(identity, std::memory_order_relaxed);
+    }
+};
+
+// how a thread of adaptive_rmw_t currently updates the value
+enum class rmw_strategy_t : uint32_t {
+    direct,     // plain compare and swap loop
+    backoff,    // compare and swap with randomized exponential backoff
+    combining   // flat combining
+};
+
+// A read-modify-write cell that chooses the strategy per thread from the
+// measured contention: every thread counts its failed compare and swaps
+// over a window of operations and moves to backoff or flat combining if
+// the failure rate exceeds the given thresholds (and back if it drops).
+// All strategies commit with compare and swap, so they can be mixed.
+template <
+    typename value_t,
+    typename funct_t>
+class adaptive_rmw_t {
+
+private:
+    struct stats_t {
+        rmw_strategy_t strategy;
+        uint64_t operations;
+        uint64_t failures;
+        uint64_t switches;
+        stats_t() : strategy(rmw_strategy_t::direct),
+                    operations(0), failures(0), switches(0) {}
+    };
+
+    std::atomic<value_t> value;
+    funct_t function;
+    flat_combiner_t<value_t, funct_t> combiner;
+    padded_array_t<stats_t> stats;
+
+    // re-evaluate after window operations, failures per operation
+    // above lower (upper) switch to backoff (combining)
+    uint64_t window;
+    double lower;
+    double upper;
+
+    value_t apply_cas(
+        const value_t& operand,
+        stats_t& stat,
+        bool with_backoff) {
+
+        value_t expect = value.load(std::memory_order_relaxed);
+        backoff_t backoff;
+
+        while (true) {
+            const value_t target = function(expect, operand);
+
+            // no-op updates need no write, the load linearizes them
+            if (target == expect ||
+                value.compare_exchange_weak(expect, target))
+                return expect;
+
+            stat.failures++;
+            if (with_backoff)
+                backoff();
+        }
+    }
+
+    void adapt(stats_t& stat) {
+
+        const double rate = double(stat.failures)/double(stat.operations);
+        auto strategy = rmw_strategy_t::direct;
+
+        // the combiner hides the failures of the combined threads,
+        // hence combining threads only leave on an uncontended window
+        if (rate > upper ||
+            (stat.strategy == rmw_strategy_t::combining && rate > 0))
+            strategy = rmw_strategy_t::combining;
+        else if (rate > lower)
+            strategy = rmw_strategy_t::backoff;
+
+        stat.switches += strategy != stat.strategy;
+        stat.strategy = strategy;
+        stat.operations = 0;
+        stat.failures = 0;
+    }
+
+public:
+    adaptive_rmw_t(
+        const value_t& init,
+        funct_t function_,
+        uint64_t num_threads,
+        uint64_t window_=1024,
+        double lower_=0.05,
+        double upper_=0.5) :
+        value(init),
+        function(function_),
+        combiner(value, function_, num_threads),
+        stats(num_threads),
+        window(window_),
+        lower(lower_),
+        upper(upper_) {}
+
+    // apply function(value, operand) on behalf of thread id
+    // and return the previous value
+    value_t apply(
+        const value_t& operand,
+        uint64_t id) {
+
+        stats_t& stat = stats[id];
+        value_t result;
+
+        if (stat.strategy == rmw_strategy_t::combining) {
+            // count a failure whenever somebody else combined for us
+            const value_t before = value.load(std::memory_order_relaxed);
+            result = combiner.apply(operand, id);
+            stat.failures += !(result == before);
+        } else {
+            result = apply_cas(operand, stat,
+                               stat.strategy == rmw_strategy_t::backoff);
+        }
+
+        if (++stat.operations == window)
+            adapt(stat);
+
+        return result;
+    }
+
+    value_t load() const {
+        return value.load();
+    }
+
+    rmw_strategy_t strategy(uint64_t id) const {
+        return stats[id].strategy;
+    }
+
+    uint64_t switches(uint64_t id) const {
+        return stats[id].switches;
+    }
+};
+
+#endif
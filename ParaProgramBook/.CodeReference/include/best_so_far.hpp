@@ -0,0 +1,271 @@
+#ifndef BEST_SO_FAR_HPP
+#define BEST_SO_FAR_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <functional>
+#include <type_traits>
+
+#include "atomic_rmw.hpp"   // cpu_relax, CACHE_LINE_SIZE
+
+// cmpxchg16b is only emitted inline with -mcx16 (or a -march that has it)
+#if defined(__x86_64__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+    #define BEST_SO_FAR_HAS_CAS16
+#endif
+
+// a key and the payload that achieved it, e.g. the value of a
+// branch and bound solution and its bit mask or an argmax
+template <
+    typename key_t,
+    typename payload_t>
+struct best_state_t {
+    key_t key;
+    payload_t payload;
+};
+
+// Storage of a best_state_t: a single 16 byte word updated with
+// cmpxchg16b if both fit into 8 bytes (fits_dwcas), a sequence lock
+// otherwise.
+// In both cases the key alone can be read with a relaxed load.
+template <
+    typename key_t,
+    typename payload_t,
+    bool fits_dwcas=(sizeof(key_t) <= 8 && sizeof(payload_t) <= 8)>
+class best_cell_t;
+
+#ifdef BEST_SO_FAR_HAS_CAS16
+template <
+    typename key_t,
+    typename payload_t>
+class best_cell_t<key_t, payload_t, true> {
+
+private:
+    typedef unsigned __int128 word_t;
+    typedef best_state_t<key_t, payload_t> state_t;
+
+    static_assert(sizeof(state_t) <= sizeof(word_t),
+                  "state does not fit into 16 bytes");
+
+    alignas(16) word_t word;
+
+    // padding bytes take part in the comparison, hence always zero them
+    static word_t pack(const state_t& state) {
+        word_t result = 0;
+        std::memcpy(&result, &state, sizeof(state_t));
+        return result;
+    }
+
+    static state_t unpack(const word_t& word) {
+        state_t result;
+        std::memcpy(&result, &word, sizeof(state_t));
+        return result;
+    }
+
+public:
+    static constexpr bool lock_free = true;
+
+    best_cell_t(const state_t& state) : word(pack(state)) {}
+
+    key_t key() const {
+        // the key occupies the low bytes of the aligned word
+        return __atomic_load_n(reinterpret_cast<const key_t*>(&word),
+                               __ATOMIC_RELAXED);
+    }
+
+    state_t load() const {
+        // a compare and swap of zero with zero is an atomic 16 byte load
+        auto ptr = const_cast<word_t*>(&word);
+        return unpack(__sync_val_compare_and_swap(ptr, word_t(0), word_t(0)));
+    }
+
+    // two relaxed 8 byte loads: possibly torn, but good enough as the
+    // expected value of a compare and swap and cheaper than load()
+    state_t peek() const {
+        auto halves = reinterpret_cast<const uint64_t*>(&word);
+        const uint64_t lower = __atomic_load_n(halves+0, __ATOMIC_RELAXED);
+        const uint64_t upper = __atomic_load_n(halves+1, __ATOMIC_RELAXED);
+        return unpack((word_t(upper) << 64) | lower);
+    }
+
+    // replace expect with target, on failure expect is the current state
+    bool compare_exchange(state_t& expect, const state_t& target) {
+        const word_t old_word = pack(expect);
+        const word_t cur_word = __sync_val_compare_and_swap(&word, old_word,
+                                                            pack(target));
+        if (cur_word == old_word)
+            return true;
+        expect = unpack(cur_word);
+        return false;
+    }
+};
+#endif
+
+// the sequence lock: odd sequence numbers mark a write in progress,
+// readers retry whenever the number changed while they copied
+template <
+    typename key_t,
+    typename payload_t,
+    bool fits_dwcas>
+class best_cell_t {
+
+private:
+    typedef best_state_t<key_t, payload_t> state_t;
+
+    static_assert(std::is_trivially_copyable<state_t>::value,
+                  "state must be trivially copyable");
+
+    std::atomic<uint64_t> sequence;
+    std::atomic<key_t> best_key;
+    state_t state;
+
+public:
+    static constexpr bool lock_free = false;
+
+    best_cell_t(const state_t& state_) :
+        sequence(0), best_key(state_.key), state(state_) {}
+
+    key_t key() const {
+        return best_key.load(std::memory_order_relaxed);
+    }
+
+    state_t load() const {
+        state_t result;
+        uint64_t before, after;
+        do {
+            while ((before = sequence.load(std::memory_order_acquire)) & 1)
+                cpu_relax();
+            std::memcpy(&result, &state, sizeof(state_t));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while (before != after);
+        return result;
+    }
+
+    state_t peek() const {
+        return load();
+    }
+
+    bool compare_exchange(state_t& expect, const state_t& target) {
+
+        // take the write lock by making the sequence number odd
+        uint64_t seq = sequence.load(std::memory_order_relaxed);
+        do {
+            while (seq & 1) {
+                cpu_relax();
+                seq = sequence.load(std::memory_order_relaxed);
+            }
+        } while (!sequence.compare_exchange_weak(seq, seq+1,
+                                                 std::memory_order_acquire));
+
+        const bool equal = !std::memcmp(&state, &expect, sizeof(state_t));
+        if (equal) {
+            state = target;
+            best_key.store(target.key, std::memory_order_relaxed);
+        } else {
+            expect = state;
+        }
+
+        sequence.store(seq+2, std::memory_order_release);
+        return equal;
+    }
+};
+
+// Lock-free best-so-far reduction: update(key, payload) installs the
+// pair if better(key, current key) holds. The key is read relaxed first,
+// so candidates that cannot win never issue a compare and swap, i.e. in
+// the common case (a good bound is known) the cache line stays shared.
+template <
+    typename key_t,
+    typename payload_t,
+    typename compare_t=std::greater<key_t>>
+class atomic_best_t {
+
+public:
+    typedef best_state_t<key_t, payload_t> state_t;
+
+private:
+    alignas(CACHE_LINE_SIZE) best_cell_t<key_t, payload_t> cell;
+    compare_t better;
+
+public:
+    static constexpr bool lock_free = best_cell_t<key_t, payload_t>::lock_free;
+
+    atomic_best_t(
+        const key_t& key,
+        const payload_t& payload,
+        compare_t better_=compare_t()) :
+        cell(state_t{key, payload}), better(better_) {}
+
+    // a possibly stale key: the best key only ever improves,
+    // hence a stale read is a conservative bound
+    key_t key() const {
+        return cell.key();
+    }
+
+    // consistent key and payload
+    state_t load() const {
+        return cell.load();
+    }
+
+    bool can_improve(const key_t& key) const {
+        return better(key, cell.key());
+    }
+
+    // returns true if (key, payload) became the best state
+    bool update(
+        const key_t& key,
+        const payload_t& payload) {
+
+        if (!can_improve(key))
+            return false;
+
+        state_t expect = cell.peek();
+        const state_t target{key, payload};
+
+        while (better(key, expect.key))
+            if (cell.compare_exchange(expect, target))
+                return true;
+
+        return false;
+    }
+
+    // Per-thread pre-filter: remembers the last global key the thread
+    // has seen and rejects candidates against it without touching the
+    // shared cache line at all. The local key is only refreshed when a
+    // candidate passes, so it is a conservative and possibly stale bound:
+    // it may let through candidates the global state would reject, but
+    // it never rejects a true improvement.
+    class local_filter_t {
+
+    private:
+        atomic_best_t& global;
+        key_t local_key;
+
+    public:
+        local_filter_t(atomic_best_t& global_) :
+            global(global_), local_key(global_.key()) {}
+
+        bool update(
+            const key_t& key,
+            const payload_t& payload) {
+
+            if (!global.better(key, local_key))
+                return false;
+
+            const bool success = global.update(key, payload);
+            local_key = success ? key : global.key();
+            return success;
+        }
+
+        key_t key() const {
+            return local_key;
+        }
+    };
+
+    local_filter_t local_filter() {
+        return local_filter_t(*this);
+    }
+};
+
+#endif
@@ -2,6 +2,8 @@
 #define BINARY_IO_HPP
 
 #include <string>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 
 template <
@@ -23,11 +25,86 @@ template <
 void load_binary(
     const value_t * data, 
     const index_t length, 
-    std::string filename) {
+    std::string filename,
+    const index_t offset=0) {
 
+    // offset is given in elements, not bytes
     std::ifstream ifile(filename.c_str(), std::ios::binary);
+    ifile.seekg(sizeof(value_t)*offset);
     ifile.read((char*) data, sizeof(value_t)*length);
     ifile.close();
 }
 
+// Header of a matrix file, the rows*cols values follow in row-major
+// order. iteration lets a solver resume from a checkpoint.
+struct matrix_header_t {
+    char magic[8];
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t value_size;
+    uint64_t iteration;
+};
+
+inline matrix_header_t make_matrix_header(
+    uint64_t rows,
+    uint64_t cols,
+    uint64_t value_size,
+    uint64_t iteration=0) {
+
+    matrix_header_t header;
+    std::memcpy(header.magic, "MATRIX1", 8);
+    header.rows = rows;
+    header.cols = cols;
+    header.value_size = value_size;
+    header.iteration = iteration;
+    return header;
+}
+
+inline bool is_matrix_header(const matrix_header_t& header) {
+    return !std::memcmp(header.magic, "MATRIX1", 8);
+}
+
+template <
+    typename value_t>
+bool dump_matrix_binary(
+    const value_t * data,
+    const uint64_t rows,
+    const uint64_t cols,
+    std::string filename,
+    const uint64_t iteration=0) {
+
+    const auto header = make_matrix_header(rows, cols,
+                                           sizeof(value_t), iteration);
+    std::ofstream ofile(filename.c_str(), std::ios::binary);
+    ofile.write((char*) &header, sizeof(header));
+    ofile.write((char*) data, sizeof(value_t)*rows*cols);
+    return bool(ofile);
+}
+
+// false if the file cannot be read or is no matrix file
+inline bool load_matrix_header(
+    std::string filename,
+    matrix_header_t& header) {
+
+    std::ifstream ifile(filename.c_str(), std::ios::binary);
+    ifile.read((char*) &header, sizeof(header));
+    return ifile && is_matrix_header(header);
+}
+
+template <
+    typename value_t>
+bool load_matrix_binary(
+    value_t * data,
+    const matrix_header_t& header,
+    std::string filename) {
+
+    if (header.value_size != sizeof(value_t))
+        return false;
+
+    std::ifstream ifile(filename.c_str(), std::ios::binary);
+    ifile.seekg(sizeof(header));
+    ifile.read((char*) data, sizeof(value_t)*header.rows*header.cols);
+    return bool(ifile);
+}
+
 #endif
@@ -4,6 +4,21 @@
 #include <fstream>
 #include <cstdint>
 #include <limits>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "hpc_helpers.hpp"  // SDIV
+
+#if defined(__AVX2__) && !defined(__CUDACC__)
+    #include <immintrin.h>
+#endif
 
 struct radiation_cmap_t {
     const uint8_t table_rgb[256][3] = {
@@ -187,6 +202,450 @@ void dump_bitmap(
     ofile.close();
 }
 
+// ----------------------------------------------------------------------------
+// batched and parallel bitmap encoder
+// ----------------------------------------------------------------------------
+
+// the color map evaluated once for all 256 levels: the low three
+// bytes of each entry are the b, g, r bytes of a 24-bit pixel
+template <
+    typename cmap_t>
+struct bitmap_lut_t {
+
+    uint32_t bgr[256];
+
+    bitmap_lut_t() {
+        const cmap_t cmap;
+        for (int level = 0; level < 256; level++)
+            bgr[level] = cmap.bgr(level, 0, 255);
+    }
+};
+
+// calls func(lower, upper) for num_threads blocks of [0, length)
+template <
+    typename index_t,
+    typename funct_t>
+void bitmap_parallel_for(
+    index_t length,
+    funct_t func,
+    index_t num_threads) {
+
+    if (length == 0)
+        return;
+
+    num_threads = std::max<index_t>(1, std::min(num_threads, length));
+    if (num_threads == 1) {
+        func(index_t(0), length);
+        return;
+    }
+
+    const index_t chunk = SDIV(length, num_threads);
+    std::vector<std::thread> threads;
+
+    for (index_t id = 0; id < num_threads; id++) {
+        const index_t lower = id*chunk;
+        const index_t upper = std::min(lower+chunk, length);
+        if (lower < upper)
+            threads.emplace_back(func, lower, upper);
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+template <
+    typename index_t,
+    typename value_t>
+void bitmap_minmax(
+    const value_t * data,
+    index_t length,
+    value_t& minimum,
+    value_t& maximum,
+    index_t num_threads=1) {
+
+    // the identities of min and max if there is nothing to scan
+    minimum = +std::numeric_limits<value_t>::infinity();
+    maximum = -std::numeric_limits<value_t>::infinity();
+    if (length == 0)
+        return;
+
+    // every block scans on its own and merges once under the lock
+    std::mutex mutex;
+    auto block = [&] (index_t lower, index_t upper) -> void {
+        value_t lmin = +std::numeric_limits<value_t>::infinity();
+        value_t lmax = -std::numeric_limits<value_t>::infinity();
+        for (index_t i = lower; i < upper; i++) {
+            lmax = data[i] > lmax ? data[i] : lmax;
+            lmin = data[i] < lmin ? data[i] : lmin;
+        }
+        std::lock_guard<std::mutex> lock_guard(mutex);
+        minimum = std::min(minimum, lmin);
+        maximum = std::max(maximum, lmax);
+    };
+
+    bitmap_parallel_for(length, block, num_threads);
+}
+
+// maps one row of values to color levels 0..255 using exactly the
+// arithmetic of the color maps: uint8_t(255*(value-min)/(max-min))
+template <
+    typename index_t,
+    typename value_t>
+void bitmap_levels(
+    const value_t * row,
+    uint8_t * levels,
+    index_t width,
+    value_t minimum,
+    value_t maximum) {
+
+    for (index_t x = 0; x < width; x++)
+        levels[x] = uint8_t(255*(row[x]-minimum)/(maximum-minimum));
+}
+
+// maps one row of levels to packed 24-bit pixels
+template <
+    typename index_t>
+void bitmap_pixels(
+    const uint8_t * levels,
+    uint8_t * pixels,
+    index_t width,
+    const uint32_t * lut) {
+
+    for (index_t x = 0; x < width; x++) {
+        const uint32_t color = lut[levels[x]];
+        pixels[3*x+0] = color >>  0;
+        pixels[3*x+1] = color >>  8;
+        pixels[3*x+2] = color >> 16;
+    }
+}
+
+#if defined(__AVX2__) && !defined(__CUDACC__)
+// AVX2 path for float: normalize eight values at once, gather their
+// colors from the table and compact 4-byte to 3-byte pixels by shuffles
+template <
+    typename index_t>
+void bitmap_pixels_avx2(
+    const float * row,
+    uint8_t * pixels,
+    index_t width,
+    float minimum,
+    float maximum,
+    const uint32_t * lut) {
+
+    const __m256 MIN = _mm256_set1_ps(minimum);
+    const __m256 RNG = _mm256_set1_ps(maximum-minimum);
+    const __m256 SCL = _mm256_set1_ps(255.0f);
+    const __m256i ZERO = _mm256_set1_epi32(0);
+    const __m256i FULL = _mm256_set1_epi32(255);
+
+    // drop every fourth byte of four packed 32-bit pixels
+    const __m128i PACK = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+                                       12, 13, 14, -1, -1, -1, -1);
+    index_t x = 0;
+    for (; x+8 <= width; x += 8) {
+        __m256 V = _mm256_loadu_ps(row+x);
+        V = _mm256_div_ps(_mm256_mul_ps(SCL, _mm256_sub_ps(V, MIN)), RNG);
+
+        __m256i L = _mm256_cvttps_epi32(V);
+        L = _mm256_min_epi32(_mm256_max_epi32(L, ZERO), FULL);
+
+        const __m256i C = _mm256_i32gather_epi32((const int*) lut, L, 4);
+        const __m128i lo = _mm_shuffle_epi8(_mm256_castsi256_si128(C), PACK);
+        const __m128i hi = _mm_shuffle_epi8(_mm256_extracti128_si256(C, 1), PACK);
+
+        // lo and hi hold four pixels in bytes 0..11 each, bytes 12..15
+        // are zero. The 16 byte stores only go to tmp, and exactly 12
+        // bytes are copied out: lo to pixels[3x, 3x+12) and hi to
+        // pixels[3x+12, 3x+24). No byte of the row is written twice and
+        // nothing beyond pixel x+7, i.e. past the end of the row
+        uint8_t tmp[16];
+        _mm_storeu_si128((__m128i*) tmp, lo);
+        std::copy(tmp, tmp+12, pixels+3*x);
+        _mm_storeu_si128((__m128i*) tmp, hi);
+        std::copy(tmp, tmp+12, pixels+3*x+12);
+    }
+
+    for (; x < width; x++) {
+        const uint8_t level = 255*(row[x]-minimum)/(maximum-minimum);
+        const uint32_t color = lut[level];
+        pixels[3*x+0] = color >>  0;
+        pixels[3*x+1] = color >>  8;
+        pixels[3*x+2] = color >> 16;
+    }
+}
+#endif
+
+template <
+    typename index_t,
+    typename value_t>
+void bitmap_row(
+    const value_t * row,
+    uint8_t * pixels,
+    uint8_t * levels,
+    index_t width,
+    value_t minimum,
+    value_t maximum,
+    const uint32_t * lut) {
+
+    bitmap_levels(row, levels, width, minimum, maximum);
+    bitmap_pixels(levels, pixels, width, lut);
+}
+
+#if defined(__AVX2__) && !defined(__CUDACC__)
+template <
+    typename index_t>
+void bitmap_row(
+    const float * row,
+    uint8_t * pixels,
+    uint8_t * levels,
+    index_t width,
+    float minimum,
+    float maximum,
+    const uint32_t * lut) {
+
+    bitmap_pixels_avx2(row, pixels, width, minimum, maximum, lut);
+}
+#endif
+
+inline void bitmap_put32(uint8_t * dst, uint32_t value) {
+    dst[0] = value >>  0;
+    dst[1] = value >>  8;
+    dst[2] = value >> 16;
+    dst[3] = value >> 24;
+}
+
+// the 54 byte file and info headers
+inline void bitmap_headers(
+    uint8_t * header,
+    uint32_t height,
+    uint32_t width,
+    uint32_t bits_per_pixel,
+    uint32_t compression,
+    uint32_t data_offset,
+    uint32_t data_size,
+    uint32_t colors_used) {
 
+    std::fill(header, header+54, 0);
+
+    header[0] = 'B';
+    header[1] = 'M';
+    bitmap_put32(header+ 2, data_offset+data_size);
+    bitmap_put32(header+10, data_offset);
+
+    bitmap_put32(header+14, 40);
+    bitmap_put32(header+18, width);
+    bitmap_put32(header+22, height);
+    header[26] = 1;
+    header[28] = bits_per_pixel;
+    bitmap_put32(header+30, compression);
+    bitmap_put32(header+34, data_size);
+    bitmap_put32(header+46, colors_used);
+}
+
+// BI_RLE8 encoding of one row of levels: runs as (count, level),
+// literal stretches of at least three bytes in absolute mode
+inline void bitmap_rle8_row(
+    const uint8_t * levels,
+    uint32_t width,
+    std::vector<uint8_t>& out) {
+
+    uint32_t x = 0;
+    while (x < width) {
+
+        uint32_t run = 1;
+        while (x+run < width && run < 255 && levels[x+run] == levels[x])
+            run++;
+
+        if (run > 1) {
+            out.push_back(run);
+            out.push_back(levels[x]);
+            x += run;
+            continue;
+        }
+
+        // collect literals until a run of three begins
+        uint32_t num = 0;
+        while (x+num < width && num < 255) {
+            if (x+num+2 < width &&
+                levels[x+num] == levels[x+num+1] &&
+                levels[x+num] == levels[x+num+2])
+                break;
+            num++;
+        }
+
+        if (num < 3) {
+            for (uint32_t i = 0; i < num; i++) {
+                out.push_back(1);
+                out.push_back(levels[x+i]);
+            }
+        } else {
+            out.push_back(0);
+            out.push_back(num);
+            out.insert(out.end(), levels+x, levels+x+num);
+            if (num % 2)
+                out.push_back(0);
+        }
+        x += num;
+    }
+
+    // end of line
+    out.push_back(0);
+    out.push_back(0);
+}
+
+// encodes a whole bitmap file into memory. The default is the same
+// 24-bit image dump_bitmap writes. With compress=true an 8-bit image
+// with the color map as 256-entry palette and BI_RLE8 compression is
+// produced instead, which is still a plain .bmp for every viewer.
+template <
+    typename index_t,
+    typename value_t,
+    typename cmap_t=grayscale_cmap_t>
+void encode_bitmap(
+    const value_t * data,
+    index_t height,
+    index_t width,
+    std::vector<uint8_t>& file,
+    bool compress=false,
+    index_t num_threads=1) {
+
+    static const bitmap_lut_t<cmap_t> lut;
+
+    value_t minimum, maximum;
+    bitmap_minmax(data, height*width, minimum, maximum, num_threads);
+
+    if (!compress) {
+
+        const index_t extra_bytes = (4-((width*3)%4))%4;
+        const index_t row_bytes = width*3+extra_bytes;
+        const index_t padded_size = row_bytes*height;
+
+        file.assign(54+padded_size, 0);
+        bitmap_headers(file.data(), height, width, 24, 0,
+                       54, padded_size, 0);
+
+        // rows are independent: encode blocks of rows in parallel
+        auto rows = [&] (index_t lower, index_t upper) -> void {
+            std::vector<uint8_t> levels(width);
+            for (index_t y = lower; y < upper; y++)
+                bitmap_row(data+(height-1-y)*width,
+                           file.data()+54+y*row_bytes,
+                           levels.data(), width,
+                           minimum, maximum, lut.bgr);
+        };
+
+        bitmap_parallel_for(height, rows, num_threads);
+
+        return;
+    }
+
+    // each row is compressed into its own buffer in parallel
+    std::vector<std::vector<uint8_t>> encoded(height);
+
+    auto rows = [&] (index_t lower, index_t upper) -> void {
+        std::vector<uint8_t> levels(width);
+        for (index_t y = lower; y < upper; y++) {
+            bitmap_levels(data+(height-1-y)*width, levels.data(),
+                          width, minimum, maximum);
+            bitmap_rle8_row(levels.data(), width, encoded[y]);
+        }
+    };
+
+    bitmap_parallel_for(height, rows, num_threads);
+
+    // header, palette (b, g, r, 0) and concatenated rows
+    const uint32_t data_offset = 54+4*256;
+    uint32_t data_size = 2;
+    for (const auto& row : encoded)
+        data_size += row.size();
+
+    file.assign(data_offset, 0);
+    file.reserve(data_offset+data_size);
+    bitmap_headers(file.data(), height, width, 8, 1,
+                   data_offset, data_size, 256);
+
+    for (int level = 0; level < 256; level++)
+        bitmap_put32(file.data()+54+4*level, lut.bgr[level] & 0xFFFFFF);
+
+    for (const auto& row : encoded)
+        file.insert(file.end(), row.begin(), row.end());
+
+    // end of bitmap
+    file.push_back(0);
+    file.push_back(1);
+}
+
+// writes the whole buffer with pwrite (loops over short writes)
+inline void write_bitmap_file(
+    const std::vector<uint8_t>& file,
+    std::string filename) {
+
+    const int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::runtime_error("cannot open "+filename);
+
+    size_t done = 0;
+    while (done < file.size()) {
+        const ssize_t bytes = pwrite(fd, file.data()+done,
+                                     file.size()-done, done);
+        if (bytes <= 0) {
+            close(fd);
+            throw std::runtime_error("cannot write "+filename);
+        }
+        done += bytes;
+    }
+
+    close(fd);
+}
+
+// parallel drop-in for dump_bitmap
+template <
+    typename index_t,
+    typename value_t,
+    typename cmap_t=grayscale_cmap_t>
+void dump_bitmap_parallel(
+    const value_t * data,
+    index_t height,
+    index_t width,
+    std::string filename,
+    bool compress=false,
+    index_t num_threads=std::thread::hardware_concurrency()) {
+
+    std::vector<uint8_t> file;
+    encode_bitmap<index_t, value_t, cmap_t>(data, height, width, file,
+                                            compress, num_threads);
+    write_bitmap_file(file, filename);
+}
+
+// writes num_images consecutive height x width images to filenames:
+// whole images are distributed over the threads, each thread encodes
+// into its own buffer and writes it with a single pwrite
+template <
+    typename index_t,
+    typename value_t,
+    typename cmap_t=grayscale_cmap_t>
+void dump_bitmaps(
+    const value_t * data,
+    index_t num_images,
+    index_t height,
+    index_t width,
+    const std::vector<std::string>& filenames,
+    bool compress=false,
+    index_t num_threads=std::thread::hardware_concurrency()) {
+
+    if (index_t(filenames.size()) < num_images)
+        throw std::runtime_error("dump_bitmaps: not enough filenames");
+
+    auto images = [&] (index_t lower, index_t upper) -> void {
+        std::vector<uint8_t> file;
+        for (index_t image = lower; image < upper; image++) {
+            encode_bitmap<index_t, value_t, cmap_t>(
+                data+image*height*width, height, width, file, compress);
+            write_bitmap_file(file, filenames[image]);
+        }
+    };
+
+    bitmap_parallel_for(num_images, images, num_threads);
+}
 
 #endif
@@ -0,0 +1,251 @@
+#ifndef CACHE_ALIGNED_HPP
+#define CACHE_ALIGNED_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <memory>
+#include <atomic>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+
+// the minimum distance of two objects written by different threads:
+// the value of the standard library from C++17 on, a cache line before
+#if defined(__cpp_lib_hardware_interference_size)
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Winterference-size"
+    constexpr std::size_t destructive_interference_size =
+        std::hardware_destructive_interference_size;
+    #pragma GCC diagnostic pop
+#else
+    constexpr std::size_t destructive_interference_size = 64;
+#endif
+
+// a value on a cache line of its own: size and alignment are
+// rounded up to the destructive interference size
+template <
+    typename value_t>
+struct alignas(destructive_interference_size) cache_aligned_t {
+
+    value_t value;
+
+    cache_aligned_t() : value() {}
+
+    // forwards to the constructors of value_t (but never hides copies)
+    template <
+        typename arg_t,
+        typename ... args_t,
+        typename=typename std::enable_if<!std::is_same<
+            typename std::decay<arg_t>::type, cache_aligned_t>::value>::type>
+    cache_aligned_t(arg_t&& arg, args_t&& ... args) :
+        value(std::forward<arg_t>(arg), std::forward<args_t>(args)...) {}
+
+    value_t& operator*() { return value; }
+    const value_t& operator*() const { return value; }
+    value_t * operator->() { return &value; }
+    const value_t * operator->() const { return &value; }
+};
+
+// A fixed-size array of length cache aligned elements, e.g. one
+// accumulator per thread. Unlike std::vector<cache_aligned_t<value_t>>
+// it honours the alignment before C++17 (without -faligned-new).
+template <
+    typename value_t>
+class padded_array_t {
+
+private:
+    typedef cache_aligned_t<value_t> slot_t;
+
+    struct deleter_t {
+        uint64_t length;
+        void operator()(slot_t * ptr) const {
+            for (uint64_t index = 0; index < length; index++)
+                ptr[index].~slot_t();
+            free(ptr);
+        }
+    };
+
+    std::unique_ptr<slot_t[], deleter_t> slots;
+    uint64_t length;
+
+public:
+    template <
+        typename ... args_t>
+    padded_array_t(
+        uint64_t length_,
+        const args_t& ... args) :
+        slots(nullptr, deleter_t{0}), length(length_) {
+
+        void * ptr = nullptr;
+        if (posix_memalign(&ptr, alignof(slot_t),
+                           std::max<uint64_t>(1, length)*sizeof(slot_t)))
+            throw std::bad_alloc();
+
+        // every element is constructed from the same arguments
+        slots = std::unique_ptr<slot_t[], deleter_t>(
+                    static_cast<slot_t*>(ptr), deleter_t{0});
+        for (uint64_t index = 0; index < length; index++) {
+            new (slots.get()+index) slot_t(args...);
+            slots.get_deleter().length = index+1;
+        }
+    }
+
+    value_t& operator[](uint64_t index) {
+        return slots[index].value;
+    }
+
+    const value_t& operator[](uint64_t index) const {
+        return slots[index].value;
+    }
+
+    uint64_t size() const {
+        return length;
+    }
+};
+
+#ifdef FALSE_SHARING_CHECK
+
+// Test mode only: samples every FALSE_SHARING_SAMPLE_RATE-th write of a
+// thread that passes FALSE_SHARING_WRITE and counts for every cache line
+// how often the last writer changed (a transfer of the line between two
+// cores). Transfers between different offsets of the same line are
+// false sharing, transfers on the same offset are true sharing.
+#ifndef FALSE_SHARING_SAMPLE_RATE
+    #define FALSE_SHARING_SAMPLE_RATE (16)
+#endif
+
+class false_sharing_sampler_t {
+
+private:
+    struct entry_t {
+        std::atomic<uint64_t> line;       // line address plus one
+        std::atomic<uint64_t> state;      // last writer and offset
+        std::atomic<uint64_t> writers;    // bit mask of thread tags
+        std::atomic<uint64_t> writes;
+        std::atomic<uint64_t> transfers;
+        std::atomic<uint64_t> false_transfers;
+    };
+
+    static const uint64_t table_size = 1UL << 16;
+    entry_t * table;
+
+    static uint32_t thread_tag() {
+        static std::atomic<uint32_t> counter(0);
+        static thread_local uint32_t tag = ++counter;
+        return tag;
+    }
+
+    entry_t * lookup(uint64_t line) {
+        // multiplicative hashing and linear probing, never evicts
+        uint64_t slot = (line*0x9E3779B97F4A7C15UL) >> 48;
+        for (uint64_t probe = 0; probe < table_size; probe++) {
+            entry_t& entry = table[(slot+probe) % table_size];
+            uint64_t expect = entry.line.load(std::memory_order_relaxed);
+            if (expect == line+1)
+                return &entry;
+            if (expect == 0 && entry.line.compare_exchange_strong(expect,
+                                                                  line+1))
+                return &entry;
+            if (expect == line+1)
+                return &entry;
+        }
+        return nullptr;
+    }
+
+    // without the table nothing is recorded and the report says so
+    false_sharing_sampler_t() :
+        table(static_cast<entry_t*>(calloc(table_size, sizeof(entry_t)))) {
+        if (!table)
+            std::cerr << "# false sharing sampler disabled: cannot allocate "
+                      << table_size*sizeof(entry_t) << " bytes" << std::endl;
+    }
+
+    ~false_sharing_sampler_t() {
+        free(table);
+    }
+
+public:
+    static false_sharing_sampler_t& instance() {
+        static false_sharing_sampler_t sampler;
+        return sampler;
+    }
+
+    void record(const volatile void * address) {
+
+        static thread_local uint64_t countdown = 0;
+        if (!table || countdown-- != 0)
+            return;
+        countdown = FALSE_SHARING_SAMPLE_RATE-1;
+
+        const uint64_t addr = reinterpret_cast<uint64_t>(address);
+        entry_t * entry = lookup(addr / destructive_interference_size);
+        if (!entry)
+            return;
+
+        const uint64_t tag = thread_tag();
+        const uint64_t offset = addr % destructive_interference_size;
+        const uint64_t last = entry->state.exchange(tag << 32 | offset,
+                                                    std::memory_order_relaxed);
+
+        entry->writes.fetch_add(1, std::memory_order_relaxed);
+        entry->writers.fetch_or(1UL << (tag % 64), std::memory_order_relaxed);
+        if (last && last >> 32 != tag) {
+            entry->transfers.fetch_add(1, std::memory_order_relaxed);
+            if ((last & 0xFFFFFFFF) != offset)
+                entry->false_transfers.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // prints all lines with at least min_transfers sampled transfers
+    // and returns the number of falsely shared lines among them
+    uint64_t report(
+        uint64_t min_transfers=16,
+        std::ostream& ostream=std::cout) const {
+
+        if (!table) {
+            ostream << "# false sharing sampler disabled" << std::endl;
+            return 0;
+        }
+
+        uint64_t num_false = 0;
+        for (uint64_t slot = 0; slot < table_size; slot++) {
+            const entry_t& entry = table[slot];
+            const uint64_t transfers = entry.transfers.load();
+            if (!entry.line.load() || transfers < min_transfers)
+                continue;
+
+            const bool false_sharing = 2*entry.false_transfers.load() >
+                                       transfers;
+            num_false += false_sharing;
+
+            ostream << "# shared line 0x" << std::hex
+                    << (entry.line.load()-1)*destructive_interference_size
+                    << std::dec << ": "
+                    << __builtin_popcountl(entry.writers.load())
+                    << " writers, " << entry.writes.load()
+                    << " sampled writes, " << transfers << " transfers ("
+                    << (false_sharing ? "false" : "true")
+                    << " sharing)" << std::endl;
+        }
+
+        ostream << "# " << num_false << " falsely shared lines" << std::endl;
+        return num_false;
+    }
+};
+
+#define FALSE_SHARING_WRITE(address) \
+    false_sharing_sampler_t::instance().record(address)
+#define FALSE_SHARING_REPORT() \
+    false_sharing_sampler_t::instance().report()
+
+#else
+
+// no code is generated in production builds
+#define FALSE_SHARING_WRITE(address)
+#define FALSE_SHARING_REPORT()
+
+#endif
+
+#endif
@@ -3,6 +3,21 @@
 
 #include <random>
 #include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "hpc_helpers.hpp"  // SDIV
+
+#if defined(__AVX2__) && !defined(__CUDACC__)
+    #include <immintrin.h>
+#endif
 
 template <
     typename index_t,
@@ -61,5 +76,455 @@ void generate_cbf(
     }
 }
 
+// ----------------------------------------------------------------------------
+// counter-based CBF generator
+// ----------------------------------------------------------------------------
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as
+// 1, 2, 3", SC'11): a keyed bijection of a 128-bit counter. Any value
+// of the stream can be computed without generating its predecessors,
+// so every series owns an independent stream indexed by its entry.
+struct philox4x32_t {
+
+    static constexpr uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+    static constexpr uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+    static void round(uint32_t * ctr, const uint32_t * key) {
+        const uint64_t p0 = uint64_t(M0)*ctr[0];
+        const uint64_t p1 = uint64_t(M1)*ctr[2];
+        const uint32_t c0 = uint32_t(p1 >> 32) ^ ctr[1] ^ key[0];
+        const uint32_t c2 = uint32_t(p0 >> 32) ^ ctr[3] ^ key[1];
+        ctr[1] = uint32_t(p1);
+        ctr[3] = uint32_t(p0);
+        ctr[0] = c0;
+        ctr[2] = c2;
+    }
+
+    // encrypts ctr in place with the 64-bit key (seed)
+    static void generate(uint32_t * ctr, uint64_t seed) {
+        uint32_t key[2] = {uint32_t(seed), uint32_t(seed >> 32)};
+        for (int r = 0; r < 10; r++) {
+            if (r) {
+                key[0] += W0;
+                key[1] += W1;
+            }
+            round(ctr, key);
+        }
+    }
+};
+
+// maps 32 random bits to [0, 1) using the upper 24 bits
+inline float cbf_uniform(uint32_t bits) {
+    return (bits >> 8)*(1.0f/16777216.0f);
+}
+
+// maps 32 random bits to [lower, upper] (multiply-shift reduction)
+template <
+    typename index_t>
+index_t cbf_uniform_int(uint32_t bits, index_t lower, index_t upper) {
+    return lower+index_t((uint64_t(bits)*uint64_t(upper-lower+1)) >> 32);
+}
+
+// counter layout: (block, entry_lo, entry_hi, stream) where stream 0
+// holds the per-series parameters and stream 1 the additive noise
+inline void cbf_counter(uint32_t * ctr, uint64_t entry,
+                        uint32_t stream, uint32_t block) {
+    ctr[0] = block;
+    ctr[1] = uint32_t(entry);
+    ctr[2] = uint32_t(entry >> 32);
+    ctr[3] = stream;
+}
+
+// fills 4*num_blocks uniforms of noise stream of entry, scalar version
+inline void cbf_noise_scalar(
+    float * noise,
+    uint64_t entry,
+    uint32_t first_block,
+    uint32_t num_blocks,
+    uint64_t seed) {
+
+    for (uint32_t block = 0; block < num_blocks; block++) {
+        uint32_t ctr[4];
+        cbf_counter(ctr, entry, 1, first_block+block);
+        philox4x32_t::generate(ctr, seed);
+        for (int w = 0; w < 4; w++)
+            noise[4*block+w] = cbf_uniform(ctr[w]);
+    }
+}
+
+#if defined(__AVX2__) && !defined(__CUDACC__)
+// (hi, lo) = a*m for eight 32-bit lanes
+inline void cbf_mulhilo_avx2(__m256i a, __m256i m, __m256i& hi, __m256i& lo) {
+    lo = _mm256_mullo_epi32(a, m);
+    const __m256i even = _mm256_mul_epu32(a, m);
+    const __m256i odd  = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+    hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+// eight Philox blocks per iteration in structure-of-arrays form
+inline void cbf_noise(
+    float * noise,
+    uint64_t entry,
+    uint32_t first_block,
+    uint32_t num_blocks,
+    uint64_t seed) {
+
+    const __m256i M0 = _mm256_set1_epi32(philox4x32_t::M0);
+    const __m256i M1 = _mm256_set1_epi32(philox4x32_t::M1);
+    const __m256 SCL = _mm256_set1_ps(1.0f/16777216.0f);
+    const __m256i LANE = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    uint32_t block = 0;
+    for (; block+8 <= num_blocks; block += 8) {
+
+        __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32(first_block+block), LANE);
+        __m256i c1 = _mm256_set1_epi32(uint32_t(entry));
+        __m256i c2 = _mm256_set1_epi32(uint32_t(entry >> 32));
+        __m256i c3 = _mm256_set1_epi32(1);
+
+        uint32_t k0 = uint32_t(seed), k1 = uint32_t(seed >> 32);
+        for (int r = 0; r < 10; r++) {
+            if (r) {
+                k0 += philox4x32_t::W0;
+                k1 += philox4x32_t::W1;
+            }
+            __m256i hi0, lo0, hi1, lo1;
+            cbf_mulhilo_avx2(c0, M0, hi0, lo0);
+            cbf_mulhilo_avx2(c2, M1, hi1, lo1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(k0));
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(k1));
+            c1 = lo1;
+            c3 = lo0;
+        }
+
+        // convert to floats and interleave (block, word) -> 4*block+word
+        float words[4][8];
+        _mm256_storeu_ps(words[0], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c0, 8)), SCL));
+        _mm256_storeu_ps(words[1], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c1, 8)), SCL));
+        _mm256_storeu_ps(words[2], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c2, 8)), SCL));
+        _mm256_storeu_ps(words[3], _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c3, 8)), SCL));
+
+        for (int lane = 0; lane < 8; lane++)
+            for (int w = 0; w < 4; w++)
+                noise[4*(block+lane)+w] = words[w][lane];
+    }
+
+    cbf_noise_scalar(noise+4*block, entry, first_block+block,
+                     num_blocks-block, seed);
+}
+#else
+inline void cbf_noise(
+    float * noise,
+    uint64_t entry,
+    uint32_t first_block,
+    uint32_t num_blocks,
+    uint64_t seed) {
+
+    cbf_noise_scalar(noise, entry, first_block, num_blocks, seed);
+}
+#endif
+
+// in-place Box-Muller transform of pairs of uniforms to N(0, 1), scalar
+inline void cbf_box_muller_scalar(float * noise, uint64_t length) {
+    const float two_pi = 6.283185307179586f;
+    for (uint64_t i = 0; i+1 < length; i += 2) {
+        const float radius = std::sqrt(-2.0f*std::log(1.0f-noise[i]));
+        const float theta  = two_pi*noise[i+1];
+        noise[i+0] = radius*std::cos(theta);
+        noise[i+1] = radius*std::sin(theta);
+    }
+}
+
+#if defined(__AVX2__) && defined(__FMA__) && !defined(__CUDACC__)
+// natural logarithm of eight positive normal floats (Cephes logf)
+inline __m256 cbf_log_avx2(__m256 x) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256i bits = _mm256_castps_si256(x);
+
+    // x = m*2^e with m in [0.5, 1)
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23),
+                                                   _mm256_set1_epi32(126)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+                   _mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+                   _mm256_set1_epi32(0x3F000000)));
+
+    // move m to [sqrt(1/2), sqrt(2)) and take log(1+m) of the rest
+    const __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(0.707106781186547524f),
+                                       _CMP_LT_OQ);
+    e = _mm256_sub_ps(e, _mm256_and_ps(small, one));
+    m = _mm256_sub_ps(_mm256_add_ps(m, _mm256_and_ps(small, m)), one);
+
+    const __m256 z = _mm256_mul_ps(m, m);
+    __m256 y = _mm256_set1_ps(7.0376836292e-2f);
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.1514610310e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps( 1.1676998740e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.2420140846e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps( 1.4249322787e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-1.6668057665e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps( 2.0000714765e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(-2.4999993993e-1f));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps( 3.3333331174e-1f));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+
+    y = _mm256_fmadd_ps(e, _mm256_set1_ps(-2.12194440e-4f), y);
+    y = _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, y);
+    return _mm256_fmadd_ps(e, _mm256_set1_ps(0.693359375f), _mm256_add_ps(m, y));
+}
+
+// sin and cos of 2*pi*u for eight u in [0, 1): the reduction to
+// [-pi/4, pi/4] is done on u, where subtracting quarters is exact
+inline void cbf_sincos_turns_avx2(__m256 u, __m256& sine, __m256& cosine) {
+    const __m256 quarter = _mm256_round_ps(_mm256_mul_ps(u, _mm256_set1_ps(4.0f)),
+                                           _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    const __m256 x = _mm256_mul_ps(_mm256_fnmadd_ps(quarter, _mm256_set1_ps(0.25f), u),
+                                   _mm256_set1_ps(6.283185307179586f));
+    const __m256i q = _mm256_cvtps_epi32(quarter);
+    const __m256 z = _mm256_mul_ps(x, x);
+
+    // Cephes minimax polynomials of sinf and cosf on [-pi/4, pi/4]
+    __m256 s = _mm256_set1_ps(-1.9515295891e-4f);
+    s = _mm256_fmadd_ps(s, z, _mm256_set1_ps( 8.3321608736e-3f));
+    s = _mm256_fmadd_ps(s, z, _mm256_set1_ps(-1.6666654611e-1f));
+    s = _mm256_fmadd_ps(_mm256_mul_ps(s, z), x, x);
+
+    __m256 c = _mm256_set1_ps(2.443315711809948e-5f);
+    c = _mm256_fmadd_ps(c, z, _mm256_set1_ps(-1.388731625493765e-3f));
+    c = _mm256_fmadd_ps(c, z, _mm256_set1_ps( 4.166664568298827e-2f));
+    c = _mm256_mul_ps(_mm256_mul_ps(c, z), z);
+    c = _mm256_add_ps(_mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, _mm256_set1_ps(1.0f)), c);
+
+    // angle q*pi/2+x: odd quadrants swap sin and cos, the sign of sin
+    // flips in quadrants 2 and 3, the one of cos in quadrants 1 and 2
+    const __m256i bit0 = _mm256_slli_epi32(q, 31);
+    const __m256i bit1 = _mm256_slli_epi32(_mm256_srli_epi32(q, 1), 31);
+    const __m256 swap = _mm256_castsi256_ps(_mm256_srai_epi32(bit0, 31));
+    const __m256 sin_sign = _mm256_castsi256_ps(bit1);
+    const __m256 cos_sign = _mm256_castsi256_ps(_mm256_xor_si256(bit0, bit1));
+
+    sine   = _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sin_sign);
+    cosine = _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cos_sign);
+}
+
+// eight pairs per iteration: the shuffles split even (radius) and odd
+// (angle) uniforms, the unpacks put the results back in pair order;
+// agrees with the scalar transform up to a few ulp
+inline void cbf_box_muller(float * noise, uint64_t length) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 minus_two = _mm256_set1_ps(-2.0f);
+
+    uint64_t i = 0;
+    for (; i+16 <= length; i += 16) {
+        const __m256 a = _mm256_loadu_ps(noise+i);
+        const __m256 b = _mm256_loadu_ps(noise+i+8);
+        const __m256 even = _mm256_shuffle_ps(a, b, 0x88);
+        const __m256 odd  = _mm256_shuffle_ps(a, b, 0xDD);
+
+        const __m256 radius = _mm256_sqrt_ps(_mm256_max_ps(_mm256_setzero_ps(),
+            _mm256_mul_ps(minus_two, cbf_log_avx2(_mm256_sub_ps(one, even)))));
+        __m256 sine, cosine;
+        cbf_sincos_turns_avx2(odd, sine, cosine);
+        cosine = _mm256_mul_ps(radius, cosine);
+        sine   = _mm256_mul_ps(radius, sine);
+
+        _mm256_storeu_ps(noise+i,   _mm256_unpacklo_ps(cosine, sine));
+        _mm256_storeu_ps(noise+i+8, _mm256_unpackhi_ps(cosine, sine));
+    }
+
+    cbf_box_muller_scalar(noise+i, length-i);
+}
+#else
+inline void cbf_box_muller(float * noise, uint64_t length) {
+    cbf_box_muller_scalar(noise, length);
+}
+#endif
+
+// one series: depends only on (seed, entry), never on the thread
+// that computes it or on the order in which entries are generated
+template <
+    typename index_t,
+    typename value_t,
+    typename label_t>
+void generate_cbf_entry(
+    value_t * series,
+    label_t * label,
+    index_t entry,
+    index_t num_features,
+    uint64_t seed,
+    bool gaussian_noise,
+    std::vector<float>& noise) {
+
+    uint32_t ctr[4];
+    cbf_counter(ctr, entry, 0, 0);
+    philox4x32_t::generate(ctr, seed);
+
+    // same parameter ranges as generate_cbf
+    const index_t a   = cbf_uniform_int<index_t>(ctr[0], 0.125*num_features,
+                                                         0.250*num_features);
+    const index_t bma = cbf_uniform_int<index_t>(ctr[1], 0.250*num_features,
+                                                         0.750*num_features);
+    const value_t amp = cbf_uniform(ctr[2])+6;
+
+    const uint32_t num_blocks = SDIV(num_features, 4);
+    noise.resize(4*num_blocks);
+    cbf_noise(noise.data(), entry, 0, num_blocks, seed);
+    if (gaussian_noise)
+        cbf_box_muller(noise.data(), noise.size());
+
+    // create the label (0: Cylinder, 1:Bell, 2:Funnel)
+    *label = entry % 3;
+
+    for (index_t index = 0; index < num_features; index++) {
+        value_t value = 0;
+        if (index >= a && index < a+bma) {
+            if (*label == 0)
+                value = amp;
+            if (*label == 1)
+                value = amp*(value_t(index)-value_t(a))/bma;
+            if (*label == 2)
+                value = amp*(value_t(a+bma)-value_t(index))/bma;
+        }
+        series[index] = value+noise[index];
+    }
+}
+
+// generates entries [lower, upper) with num_threads threads in blocks
+template <
+    typename index_t,
+    typename value_t,
+    typename label_t>
+void generate_cbf_range(
+    value_t * data,
+    label_t * labels,
+    index_t lower,
+    index_t upper,
+    index_t num_features,
+    index_t num_threads,
+    uint64_t seed,
+    bool gaussian_noise) {
+
+    auto block = [&] (const index_t& id) -> void {
+        const index_t chunk = SDIV(upper-lower, num_threads);
+        const index_t begin = lower+id*chunk;
+        const index_t end   = std::min(begin+chunk, upper);
+
+        std::vector<float> noise;
+        for (index_t entry = begin; entry < end; entry++)
+            generate_cbf_entry(data+(entry-lower)*num_features,
+                               labels+(entry-lower), entry,
+                               num_features, seed, gaussian_noise, noise);
+    };
+
+    std::vector<std::thread> threads;
+    for (index_t id = 0; id < num_threads; id++)
+        threads.emplace_back(block, id);
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// parallel counterpart of generate_cbf: the result is bit-identical
+// for any num_threads (but differs from the mt19937 based generate_cbf)
+template <
+    typename index_t,
+    typename value_t,
+    typename label_t>
+void generate_cbf_parallel(
+    value_t * data,
+    label_t * labels,
+    index_t num_entries,
+    index_t num_features,
+    index_t num_threads=std::thread::hardware_concurrency(),
+    uint64_t seed=42,
+    bool gaussian_noise=false) {
+
+    num_threads = std::max<index_t>(1, num_threads);
+    generate_cbf_range(data, labels, index_t(0), num_entries, num_features,
+                       num_threads, seed, gaussian_noise);
+}
+
+// writes num_entries series (and their labels) straight to disk in
+// chunks of chunk_entries: chunk c+1 is generated while a writer
+// thread stores chunk c, so memory stays at two chunks
+template <
+    typename index_t,
+    typename value_t,
+    typename label_t>
+void generate_cbf_stream(
+    std::string data_filename,
+    std::string label_filename,
+    index_t num_entries,
+    index_t num_features,
+    index_t chunk_entries=1UL << 16,
+    index_t num_threads=std::thread::hardware_concurrency(),
+    uint64_t seed=42,
+    bool gaussian_noise=false) {
+
+    num_threads = std::max<index_t>(1, num_threads);
+
+    const int data_fd = open(data_filename.c_str(),
+                             O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    const int label_fd = open(label_filename.c_str(),
+                              O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (data_fd < 0 || label_fd < 0) {
+        if (data_fd >= 0)
+            close(data_fd);
+        if (label_fd >= 0)
+            close(label_fd);
+        throw std::runtime_error("generate_cbf_stream: cannot open output");
+    }
+
+    auto write_all = [] (int fd, const void * buffer,
+                         size_t length, size_t offset) -> bool {
+        const char * bytes = static_cast<const char*>(buffer);
+        size_t done = 0;
+        while (done < length) {
+            const ssize_t written = pwrite(fd, bytes+done,
+                                           length-done, offset+done);
+            if (written <= 0)
+                return false;
+            done += written;
+        }
+        return true;
+    };
+
+    std::vector<value_t> data[2];
+    std::vector<label_t> labels[2];
+    std::thread writer;
+    bool success = true;
+
+    for (index_t lower = 0, chunk = 0; lower < num_entries;
+         lower += chunk_entries, chunk++) {
+
+        const index_t upper = std::min(lower+chunk_entries, num_entries);
+        const index_t slot = chunk % 2;
+
+        data[slot].resize((upper-lower)*num_features);
+        labels[slot].resize(upper-lower);
+        generate_cbf_range(data[slot].data(), labels[slot].data(),
+                           lower, upper, num_features,
+                           num_threads, seed, gaussian_noise);
+
+        // the previous chunk must be on disk before its slot is reused
+        if (writer.joinable())
+            writer.join();
+
+        writer = std::thread([&, slot, lower] () -> void {
+            success &= write_all(data_fd, data[slot].data(),
+                                 sizeof(value_t)*data[slot].size(),
+                                 sizeof(value_t)*lower*num_features);
+            success &= write_all(label_fd, labels[slot].data(),
+                                 sizeof(label_t)*labels[slot].size(),
+                                 sizeof(label_t)*lower);
+        });
+    }
+
+    if (writer.joinable())
+        writer.join();
+
+    close(data_fd);
+    close(label_fd);
+
+    if (!success)
+        throw std::runtime_error("generate_cbf_stream: write failed");
+}
 
 #endif
@@ -0,0 +1,273 @@
+#ifndef CPU_TOPOLOGY_HPP
+#define CPU_TOPOLOGY_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+    #include <sched.h>
+    #include <pthread.h>
+#endif
+
+// where the threads of a pool (or a kernel) are placed
+enum class pin_policy_t : uint32_t {
+    none,          // leave it to the scheduler
+    compact,       // fill a core (all its hyperthreads), then the next
+    scatter,       // round robin over nodes, then cores, then siblings
+    one_per_core,  // one thread per physical core, siblings stay idle
+    numa_local     // only the cores of the node of the creating thread
+};
+
+// the logical cpus the process may run on, with their position
+struct cpu_info_t {
+    uint32_t cpu;
+    uint32_t package;
+    uint32_t core;      // as in topology/core_id, unique per package
+    uint32_t node;
+    uint32_t sibling;   // rank among the hyperthreads of its core
+};
+
+// parses lists like "0-3,8,10-11" as found in /sys
+inline std::vector<uint32_t> parse_cpu_list(const std::string& list) {
+    std::vector<uint32_t> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty() || range == "\n")
+            continue;
+        const auto dash = range.find('-');
+        const uint32_t lower = std::stoul(range.substr(0, dash));
+        const uint32_t upper = dash == std::string::npos ? lower :
+                               std::stoul(range.substr(dash+1));
+        for (uint32_t cpu = lower; cpu <= upper; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+inline bool read_sys_file(const std::string& path, std::string& content) {
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::getline(file, content);
+    return true;
+}
+
+// Topology of the cpus in the affinity mask of the process, read from
+// /sys/devices/system/cpu and /sys/devices/system/node. If sysfs is not
+// available every cpu counts as a core of its own on node 0.
+class cpu_topology_t {
+
+private:
+    std::vector<cpu_info_t> cpus;
+    uint32_t num_nodes;
+
+    static uint32_t read_id(uint32_t cpu, const char * name) {
+        std::string content;
+        const std::string path = "/sys/devices/system/cpu/cpu"+
+                                 std::to_string(cpu)+"/topology/"+name;
+        return read_sys_file(path, content) ? std::stoul(content) : cpu;
+    }
+
+    std::vector<uint32_t> allowed_cpus() const {
+        std::vector<uint32_t> allowed;
+        #ifdef __linux__
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            if (!sched_getaffinity(0, sizeof(mask), &mask)) {
+                for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                    if (CPU_ISSET(cpu, &mask))
+                        allowed.push_back(cpu);
+                return allowed;
+            }
+        #endif
+        for (uint32_t cpu = 0; cpu < std::thread::hardware_concurrency();
+             cpu++)
+            allowed.push_back(cpu);
+        return allowed;
+    }
+
+public:
+    cpu_topology_t() : num_nodes(1) {
+
+        for (const auto& cpu : allowed_cpus())
+            cpus.push_back(cpu_info_t{cpu, read_id(cpu, "physical_package_id"),
+                                      read_id(cpu, "core_id"), 0, 0});
+
+        // the cpus of every online node
+        std::string online;
+        if (read_sys_file("/sys/devices/system/node/online", online)) {
+            for (const auto& node : parse_cpu_list(online)) {
+                std::string list;
+                if (!read_sys_file("/sys/devices/system/node/node"+
+                                   std::to_string(node)+"/cpulist", list))
+                    continue;
+                for (const auto& cpu : parse_cpu_list(list))
+                    for (auto& info : cpus)
+                        if (info.cpu == cpu)
+                            info.node = node;
+                num_nodes = std::max(num_nodes, node+1);
+            }
+        }
+
+        // compact order: node, package, core, then the hyperthreads
+        std::sort(cpus.begin(), cpus.end(),
+                  [] (const cpu_info_t& a, const cpu_info_t& b) {
+            if (a.node != b.node)       return a.node < b.node;
+            if (a.package != b.package) return a.package < b.package;
+            if (a.core != b.core)       return a.core < b.core;
+            return a.cpu < b.cpu;
+        });
+
+        for (uint64_t index = 1; index < cpus.size(); index++) {
+            const cpu_info_t& prev = cpus[index-1];
+            cpu_info_t& info = cpus[index];
+            if (info.package == prev.package && info.core == prev.core)
+                info.sibling = prev.sibling+1;
+        }
+    }
+
+    const std::vector<cpu_info_t>& logical_cpus() const {
+        return cpus;
+    }
+
+    uint64_t num_cores() const {
+        return std::count_if(cpus.begin(), cpus.end(),
+                             [] (const cpu_info_t& info) {
+                                 return info.sibling == 0; });
+    }
+
+    uint32_t nodes() const {
+        return num_nodes;
+    }
+
+    // the node of the cpu the calling thread runs on
+    uint32_t current_node() const {
+        #ifdef __linux__
+            const int cpu = sched_getcpu();
+            for (const auto& info : cpus)
+                if (int(info.cpu) == cpu)
+                    return info.node;
+        #endif
+        return 0;
+    }
+
+    // cpu of thread id = 0..num_threads-1 under the policy, threads
+    // beyond the number of eligible cpus wrap around (empty for none)
+    std::vector<uint32_t> placement(
+        pin_policy_t policy,
+        uint64_t num_threads) const {
+
+        std::vector<cpu_info_t> eligible;
+
+        switch (policy) {
+            case pin_policy_t::none:
+                return std::vector<uint32_t>();
+
+            case pin_policy_t::compact:
+                eligible = cpus;
+                break;
+
+            case pin_policy_t::one_per_core:
+                for (const auto& info : cpus)
+                    if (info.sibling == 0)
+                        eligible.push_back(info);
+                break;
+
+            case pin_policy_t::numa_local: {
+                const uint32_t node = current_node();
+                for (const auto& info : cpus)
+                    if (info.node == node)
+                        eligible.push_back(info);
+                break;
+            }
+
+            case pin_policy_t::scatter: {
+                // rank of every core within its node
+                std::vector<uint32_t> rank(cpus.size(), 0);
+                for (uint64_t index = 1; index < cpus.size(); index++) {
+                    const cpu_info_t& prev = cpus[index-1];
+                    const cpu_info_t& info = cpus[index];
+                    if (info.node != prev.node)
+                        rank[index] = 0;
+                    else if (info.sibling)
+                        rank[index] = rank[index-1];
+                    else
+                        rank[index] = rank[index-1]+1;
+                }
+
+                std::vector<uint64_t> order(cpus.size());
+                for (uint64_t index = 0; index < order.size(); index++)
+                    order[index] = index;
+                std::stable_sort(order.begin(), order.end(),
+                                 [&] (uint64_t a, uint64_t b) {
+                    if (cpus[a].sibling != cpus[b].sibling)
+                        return cpus[a].sibling < cpus[b].sibling;
+                    if (rank[a] != rank[b])
+                        return rank[a] < rank[b];
+                    return cpus[a].node < cpus[b].node;
+                });
+                for (const auto& index : order)
+                    eligible.push_back(cpus[index]);
+                break;
+            }
+        }
+
+        if (eligible.empty())
+            eligible = cpus;
+
+        std::vector<uint32_t> placed(num_threads);
+        for (uint64_t id = 0; id < num_threads; id++)
+            placed[id] = eligible[id % eligible.size()].cpu;
+        return placed;
+    }
+};
+
+// the topology does not change while we run
+inline const cpu_topology_t& cpu_topology() {
+    static const cpu_topology_t topology;
+    return topology;
+}
+
+inline pin_policy_t parse_pin_policy(const std::string& name) {
+    if (name == "" || name == "none") return pin_policy_t::none;
+    if (name == "compact")            return pin_policy_t::compact;
+    if (name == "scatter")            return pin_policy_t::scatter;
+    if (name == "one_per_core")       return pin_policy_t::one_per_core;
+    if (name == "numa_local")         return pin_policy_t::numa_local;
+    throw std::runtime_error("unknown pin policy " + name);
+}
+
+// THREAD_PIN_POLICY=none|compact|scatter|one_per_core|numa_local picks
+// the placement of the pools and kernels, threads are not pinned without
+// it. The spawning thread computes placement() once and every thread pins
+// itself to its entry (numa_local means the node of the spawning thread).
+inline pin_policy_t pin_policy_from_env(
+    pin_policy_t fallback=pin_policy_t::none) {
+    const char * name = std::getenv("THREAD_PIN_POLICY");
+    return name ? parse_pin_policy(name) : fallback;
+}
+
+// false if the cpu cannot be pinned to, a cpu_set_t holds
+// CPU_SETSIZE cpus and CPU_SET beyond that is undefined
+inline bool pin_this_thread(uint32_t cpu) {
+    #ifdef __linux__
+        if (cpu >= CPU_SETSIZE)
+            return false;
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu, &mask);
+        return !pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+    #else
+        return false;
+    #endif
+}
+
+#endif
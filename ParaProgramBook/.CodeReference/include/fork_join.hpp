@@ -0,0 +1,275 @@
+#ifndef FORK_JOIN_HPP
+#define FORK_JOIN_HPP
+
+#include <cstdint>
+#include <climits>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <functional>
+
+#include "atomic_rmw.hpp"   // spinlock_t, backoff_t, padded_array_t
+#include "futex_event.hpp"  // futex_wait, futex_wake
+
+// how spawned tasks are distributed over the workers
+enum class schedule_mode_t : uint32_t {
+    work_stealing,  // own deque (LIFO), steal from the others (FIFO)
+    central_queue   // one shared FIFO queue like ThreadPool::enqueue
+};
+
+// counts the outstanding tasks of a fork, wait() joins them
+class task_group_t {
+
+    friend class fork_join_pool_t;
+
+private:
+    std::atomic<uint64_t> pending;
+
+public:
+    task_group_t() : pending(0) {}
+
+    bool done() const {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+};
+
+// Fork-join pool for recursive task parallelism. A thread waiting for
+// its children executes queued tasks instead of blocking, hence nested
+// spawn/wait never deadlocks no matter how deep the recursion gets.
+// Every deque is guarded by a spinlock (no Chase-Lev deque), so the
+// two modes differ only in where tasks are pushed and popped.
+class fork_join_pool_t {
+
+private:
+    struct task_t {
+        std::function<void(void)> func;
+        task_group_t * group;
+    };
+
+    struct deque_t {
+        spinlock_t lock;
+        std::deque<task_t> tasks;
+        uint64_t spawned;
+        uint64_t stolen;
+        deque_t() : spawned(0), stolen(0) {}
+    };
+
+    // the calling thread's worker id in this pool
+    struct worker_t {
+        const fork_join_pool_t * pool;
+        uint64_t id;
+        uint64_t seed;
+    };
+
+    schedule_mode_t mode;
+    uint64_t num_workers;
+    // one deque per worker, the last one for outside threads
+    padded_array_t<deque_t> deques;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stop_pool;
+
+    // parked workers sleep on wake_epoch, spawn bumps it if any sleep
+    std::atomic<uint32_t> sleepers;
+    std::atomic<uint32_t> wake_epoch;
+
+    // failed attempts in a row before an idle worker parks, the backoff
+    // reaches its limit after a few of them and yields from then on
+    static constexpr uint32_t idle_limit = 64;
+
+    static worker_t& this_worker() {
+        static thread_local worker_t worker{nullptr, 0, 0};
+        return worker;
+    }
+
+    uint64_t worker_id() {
+        const worker_t& worker = this_worker();
+        return worker.pool == this ? worker.id : num_workers;
+    }
+
+    void push(uint64_t id, task_t task) {
+        deque_t& deque = deques[mode == schedule_mode_t::central_queue
+                                ? 0 : id];
+        std::lock_guard<spinlock_t> lock_guard(deque.lock);
+        deque.tasks.emplace_back(std::move(task));
+        deque.spawned++;
+    }
+
+    // the newest task of the own deque, the central queue is served
+    // in FIFO order except for waiting threads: helping with the oldest
+    // (biggest) task would nest one wait into the next without bound
+    bool pop(uint64_t id, task_t& task, bool waiting) {
+
+        const bool central = mode == schedule_mode_t::central_queue;
+        deque_t& deque = deques[central ? 0 : id];
+        std::lock_guard<spinlock_t> lock_guard(deque.lock);
+        if (deque.tasks.empty())
+            return false;
+
+        if (central && !waiting) {
+            task = std::move(deque.tasks.front());
+            deque.tasks.pop_front();
+        } else {
+            task = std::move(deque.tasks.back());
+            deque.tasks.pop_back();
+        }
+        return true;
+    }
+
+    // the oldest task (the biggest subtree) of a random victim
+    bool steal(uint64_t id, task_t& task) {
+
+        if (mode == schedule_mode_t::central_queue)
+            return false;
+
+        uint64_t& seed = this_worker().seed;
+        seed = seed*6364136223846793005UL+1442695040888963407UL;
+        const uint64_t first = (seed >> 33) % deques.size();
+
+        for (uint64_t offset = 0; offset < deques.size(); offset++) {
+            const uint64_t victim = (first+offset) % deques.size();
+            if (victim == id)
+                continue;
+
+            deque_t& deque = deques[victim];
+            std::lock_guard<spinlock_t> lock_guard(deque.lock);
+            if (deque.tasks.empty())
+                continue;
+            task = std::move(deque.tasks.front());
+            deque.tasks.pop_front();
+            deque.stolen++;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool run_one(uint64_t id, bool waiting) {
+        task_t task;
+        if (!pop(id, task, waiting) && !steal(id, task))
+            return false;
+
+        task.func();
+        task.group->pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    // announce the sleeper, then look for work once more: a spawn either
+    // sees the sleeper and bumps the epoch (futex_wait returns at once)
+    // or its task is found here, so no wake-up is lost
+    void park(uint64_t id) {
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const uint32_t epoch = wake_epoch.load(std::memory_order_seq_cst);
+        if (!run_one(id, false) && !stop_pool.load(std::memory_order_seq_cst))
+            futex_wait(wake_epoch, epoch);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // only enters the kernel if a worker is parked
+    void wake_one() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed)) {
+            wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+            futex_wake(wake_epoch, 1);
+        }
+    }
+
+public:
+    fork_join_pool_t(
+        uint64_t num_workers_=std::thread::hardware_concurrency(),
+        schedule_mode_t mode_=schedule_mode_t::work_stealing) :
+        mode(mode_),
+        num_workers(num_workers_),
+        deques(num_workers_+1),
+        stop_pool(false),
+        sleepers(0),
+        wake_epoch(0) {
+
+        // idle workers back off and yield, after idle_limit failed
+        // attempts they park until spawn wakes them
+        auto work_loop = [this] (uint64_t id) -> void {
+            this_worker() = worker_t{this, id, id+1};
+            backoff_t backoff;
+            uint32_t idle = 0;
+            while (!stop_pool.load(std::memory_order_relaxed)) {
+                if (run_one(id, false)) {
+                    backoff.reset();
+                    idle = 0;
+                } else if (++idle < idle_limit) {
+                    backoff();
+                } else {
+                    park(id);
+                    backoff.reset();
+                    idle = 0;
+                }
+            }
+        };
+
+        for (uint64_t id = 0; id < num_workers; id++)
+            threads.emplace_back(work_loop, id);
+    }
+
+    ~fork_join_pool_t() {
+        stop_pool = true;
+        wake_epoch.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake(wake_epoch, INT_MAX);
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    template <
+        typename funct_t>
+    void spawn(
+        task_group_t& group,
+        funct_t&& func) {
+
+        group.pending.fetch_add(1, std::memory_order_relaxed);
+        push(worker_id(), task_t{std::forward<funct_t>(func), &group});
+        wake_one();
+    }
+
+    // run tasks (own first, then stolen ones) until the group is done
+    void wait(
+        task_group_t& group) {
+
+        const uint64_t id = worker_id();
+        backoff_t backoff;
+        while (!group.done()) {
+            if (run_one(id, true))
+                backoff.reset();
+            else
+                backoff();
+        }
+    }
+
+    // statistics, only meaningful while no task is in flight
+    uint64_t spawned() {
+        uint64_t count = 0;
+        for (uint64_t id = 0; id < deques.size(); id++)
+            count += deques[id].spawned;
+        return count;
+    }
+
+    uint64_t stolen() {
+        uint64_t count = 0;
+        for (uint64_t id = 0; id < deques.size(); id++)
+            count += deques[id].stolen;
+        return count;
+    }
+
+    void reset_statistics() {
+        for (uint64_t id = 0; id < deques.size(); id++) {
+            std::lock_guard<spinlock_t> lock_guard(deques[id].lock);
+            deques[id].spawned = deques[id].stolen = 0;
+        }
+    }
+
+    uint64_t size() const {
+        return num_workers;
+    }
+};
+
+#endif
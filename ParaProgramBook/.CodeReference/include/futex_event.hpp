@@ -0,0 +1,185 @@
+#ifndef FUTEX_EVENT_HPP
+#define FUTEX_EVENT_HPP
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#ifdef __linux__
+    #include <unistd.h>
+    #include <sys/syscall.h>
+    #include <linux/futex.h>
+#endif
+
+#include "atomic_rmw.hpp"   // cpu_relax, cache_aligned_t
+
+// sleep while *word == expect (spurious wake-ups are allowed)
+inline void futex_wait(
+    std::atomic<uint32_t>& word,
+    uint32_t expect) {
+    #ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word),
+                FUTEX_WAIT_PRIVATE, expect, nullptr, nullptr, 0);
+    #else
+        if (word.load() == expect)
+            std::this_thread::yield();
+    #endif
+}
+
+// wake up to count threads sleeping on word
+inline void futex_wake(
+    std::atomic<uint32_t>& word,
+    uint32_t count) {
+    #ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word),
+                FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    #endif
+}
+
+// number of pause instructions before a waiter parks in the kernel:
+// a few microseconds, spinning is pointless on a single core
+inline uint32_t default_spin_limit() {
+    static const uint32_t limit =
+        std::thread::hardware_concurrency() > 1 ? 1 << 12 : 0;
+    return limit;
+}
+
+// Counting semaphore: wait() spins briefly with cpu_relax and then
+// parks on a futex, post() only enters the kernel if somebody sleeps.
+// An uncontended handoff therefore costs two atomic operations.
+class semaphore_t {
+
+private:
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> sleepers;
+    uint32_t spin_limit;
+
+    bool try_acquire() {
+        // sequentially consistent: pairs with the sleeper check in post()
+        uint32_t expect = count.load(std::memory_order_seq_cst);
+        while (expect > 0)
+            if (count.compare_exchange_weak(expect, expect-1,
+                                            std::memory_order_acquire))
+                return true;
+        return false;
+    }
+
+public:
+    semaphore_t(
+        uint32_t count_=0,
+        uint32_t spin_limit_=default_spin_limit()) :
+        count(count_), sleepers(0), spin_limit(spin_limit_) {}
+
+    void post(uint32_t num=1) {
+        count.fetch_add(num, std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_seq_cst))
+            futex_wake(count, num);
+    }
+
+    void wait() {
+
+        for (uint32_t spin = 0; spin < spin_limit; spin++) {
+            if (try_acquire())
+                return;
+            cpu_relax();
+        }
+
+        // announce the sleeper before re-checking the count, post()
+        // either sees the sleeper or we see its increment
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        while (!try_acquire())
+            futex_wait(count, 0);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    bool try_wait() {
+        return try_acquire();
+    }
+};
+
+// Manual-reset event: wait() returns once set() was called and
+// keeps returning immediately until reset().
+class event_t {
+
+private:
+    std::atomic<uint32_t> state;
+    std::atomic<uint32_t> sleepers;
+    uint32_t spin_limit;
+
+public:
+    event_t(
+        bool set_=false,
+        uint32_t spin_limit_=default_spin_limit()) :
+        state(set_), sleepers(0), spin_limit(spin_limit_) {}
+
+    void set() {
+        state.store(1, std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_seq_cst))
+            futex_wake(state, INT32_MAX);
+    }
+
+    void reset() {
+        state.store(0, std::memory_order_relaxed);
+    }
+
+    bool is_set() const {
+        return state.load(std::memory_order_acquire);
+    }
+
+    void wait() {
+
+        for (uint32_t spin = 0; spin < spin_limit; spin++) {
+            if (is_set())
+                return;
+            cpu_relax();
+        }
+
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        while (!state.load(std::memory_order_seq_cst))
+            futex_wait(state, 0);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+// Blocking single-producer/single-consumer channel over a ring of
+// capacity slots: send() waits for a free slot, receive() for a full
+// one. With capacity 1 it is a rendezvous-like handoff of one value.
+template <
+    typename value_t>
+class handoff_channel_t {
+
+private:
+    // the producer and the consumer side on lines of their own
+    std::vector<value_t> slots;
+    cache_aligned_t<semaphore_t> free_slots;
+    cache_aligned_t<semaphore_t> full_slots;
+    cache_aligned_t<uint64_t> head;  // only touched by the consumer
+    cache_aligned_t<uint64_t> tail;  // only touched by the producer
+
+public:
+    handoff_channel_t(
+        uint64_t capacity=1,
+        uint32_t spin_limit=default_spin_limit()) :
+        slots(capacity),
+        free_slots(uint32_t(capacity), spin_limit),
+        full_slots(uint32_t(0), spin_limit),
+        head(uint64_t(0)), tail(uint64_t(0)) {}
+
+    void send(value_t value) {
+        free_slots->wait();
+        slots[*tail] = std::move(value);
+        *tail = *tail+1 == slots.size() ? 0 : *tail+1;
+        full_slots->post();
+    }
+
+    value_t receive() {
+        full_slots->wait();
+        value_t value = std::move(slots[*head]);
+        *head = *head+1 == slots.size() ? 0 : *head+1;
+        free_slots->post();
+        return value;
+    }
+};
+
+#endif
@@ -0,0 +1,282 @@
+#ifndef LOCKFREE_QUEUE_HPP
+#define LOCKFREE_QUEUE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+
+#include "atomic_rmw.hpp"   // backoff_t, cache_aligned_t
+
+// the capacity of the ring buffers is rounded up to a power of two
+inline uint64_t queue_capacity(uint64_t capacity) {
+    uint64_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+    return size;
+}
+
+// Bounded single-producer/single-consumer queue (Lamport's ring buffer).
+// Producer and consumer each keep a private copy of the other's index
+// and only reload the shared one if the copy says full (empty), so in
+// steady state neither side reads the other side's cache line.
+template <
+    typename value_t>
+class spsc_queue_t {
+
+private:
+    struct producer_t {
+        std::atomic<uint64_t> tail;
+        uint64_t cached_head;
+    };
+
+    struct consumer_t {
+        std::atomic<uint64_t> head;
+        uint64_t cached_tail;
+    };
+
+    std::vector<value_t> buffer;
+    uint64_t mask;
+    cache_aligned_t<producer_t> producer;
+    cache_aligned_t<consumer_t> consumer;
+
+    // number of free slots as seen by the producer, the shared
+    // index is only read if the cached one promises too few
+    uint64_t writable(uint64_t tail, uint64_t needed) {
+        if (buffer.size()-(tail-producer->cached_head) < needed)
+            producer->cached_head =
+                consumer->head.load(std::memory_order_acquire);
+        return buffer.size()-(tail-producer->cached_head);
+    }
+
+    // number of full slots as seen by the consumer
+    uint64_t readable(uint64_t head, uint64_t needed) {
+        if (consumer->cached_tail-head < needed)
+            consumer->cached_tail =
+                producer->tail.load(std::memory_order_acquire);
+        return consumer->cached_tail-head;
+    }
+
+public:
+    spsc_queue_t(
+        uint64_t capacity) :
+        buffer(queue_capacity(capacity)),
+        mask(buffer.size()-1) {
+        producer->tail.store(0);
+        producer->cached_head = 0;
+        consumer->head.store(0);
+        consumer->cached_tail = 0;
+    }
+
+    template <
+        typename arg_t>
+    bool try_push(arg_t&& value) {
+        const uint64_t tail = producer->tail.load(std::memory_order_relaxed);
+        if (!writable(tail, 1))
+            return false;
+        buffer[tail & mask] = std::forward<arg_t>(value);
+        producer->tail.store(tail+1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(value_t& value) {
+        const uint64_t head = consumer->head.load(std::memory_order_relaxed);
+        if (!readable(head, 1))
+            return false;
+        value = std::move(buffer[head & mask]);
+        consumer->head.store(head+1, std::memory_order_release);
+        return true;
+    }
+
+    // push up to count values with a single index update,
+    // returns the number of values pushed
+    uint64_t try_push_bulk(const value_t * values, uint64_t count) {
+        const uint64_t tail = producer->tail.load(std::memory_order_relaxed);
+        count = std::min(count, writable(tail, count));
+        for (uint64_t index = 0; index < count; index++)
+            buffer[(tail+index) & mask] = values[index];
+        producer->tail.store(tail+count, std::memory_order_release);
+        return count;
+    }
+
+    // pop up to count values with a single index update,
+    // returns the number of values popped
+    uint64_t try_pop_bulk(value_t * values, uint64_t count) {
+        const uint64_t head = consumer->head.load(std::memory_order_relaxed);
+        count = std::min(count, readable(head, count));
+        for (uint64_t index = 0; index < count; index++)
+            values[index] = std::move(buffer[(head+index) & mask]);
+        consumer->head.store(head+count, std::memory_order_release);
+        return count;
+    }
+
+    // blocking variants that back off while the queue is full (empty)
+    template <
+        typename arg_t>
+    void push(arg_t&& value) {
+        backoff_t backoff;
+        while (!try_push(std::forward<arg_t>(value)))
+            backoff();
+    }
+
+    value_t pop() {
+        value_t value;
+        backoff_t backoff;
+        while (!try_pop(value))
+            backoff();
+        return value;
+    }
+
+    uint64_t size_approx() const {
+        return producer->tail.load(std::memory_order_relaxed)-
+               consumer->head.load(std::memory_order_relaxed);
+    }
+
+    uint64_t capacity() const {
+        return buffer.size();
+    }
+};
+
+// Bounded multi-producer/multi-consumer queue after Dmitry Vyukov: every
+// cell carries a sequence number telling producers (sequence == position)
+// and consumers (sequence == position+1) whose turn it is, so a push or
+// pop is one compare and swap on the shared index plus one release store.
+template <
+    typename value_t>
+class mpmc_queue_t {
+
+private:
+    struct cell_t {
+        std::atomic<uint64_t> sequence;
+        value_t value;
+    };
+
+    std::vector<cell_t> buffer;
+    uint64_t mask;
+    cache_aligned_t<std::atomic<uint64_t>> enqueue_pos;
+    cache_aligned_t<std::atomic<uint64_t>> dequeue_pos;
+
+    // claims up to count consecutive cells whose sequence equals
+    // position+offset, returns the first position and the number claimed
+    uint64_t claim(
+        std::atomic<uint64_t>& index,
+        uint64_t offset,
+        uint64_t count,
+        uint64_t& pos) {
+
+        pos = index.load(std::memory_order_relaxed);
+        while (true) {
+            uint64_t ready = 0;
+            while (ready < count) {
+                const uint64_t seq = buffer[(pos+ready) & mask]
+                                     .sequence.load(std::memory_order_acquire);
+                const int64_t dif = int64_t(seq)-int64_t(pos+ready+offset);
+                if (dif != 0) {
+                    // somebody else advanced the index: start over
+                    if (dif > 0 && ready == 0)
+                        ready = count+1;
+                    break;
+                }
+                ready++;
+            }
+
+            if (ready == count+1) {
+                pos = index.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (ready == 0)
+                return 0;  // full (empty)
+
+            if (index.compare_exchange_weak(pos, pos+ready,
+                                            std::memory_order_relaxed))
+                return ready;
+        }
+    }
+
+public:
+    mpmc_queue_t(
+        uint64_t capacity) :
+        buffer(queue_capacity(capacity)),
+        mask(buffer.size()-1),
+        enqueue_pos(uint64_t(0)),
+        dequeue_pos(uint64_t(0)) {
+        for (uint64_t index = 0; index < buffer.size(); index++)
+            buffer[index].sequence.store(index, std::memory_order_relaxed);
+    }
+
+    template <
+        typename arg_t>
+    bool try_push(arg_t&& value) {
+        uint64_t pos;
+        if (!claim(*enqueue_pos, 0, 1, pos))
+            return false;
+        cell_t& cell = buffer[pos & mask];
+        cell.value = std::forward<arg_t>(value);
+        cell.sequence.store(pos+1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(value_t& value) {
+        uint64_t pos;
+        if (!claim(*dequeue_pos, 1, 1, pos))
+            return false;
+        cell_t& cell = buffer[pos & mask];
+        value = std::move(cell.value);
+        cell.sequence.store(pos+mask+1, std::memory_order_release);
+        return true;
+    }
+
+    // claims as many consecutive cells as are ready (at most count)
+    // with a single compare and swap, returns the number pushed
+    uint64_t try_push_bulk(const value_t * values, uint64_t count) {
+        uint64_t pos;
+        count = claim(*enqueue_pos, 0, count, pos);
+        for (uint64_t index = 0; index < count; index++) {
+            cell_t& cell = buffer[(pos+index) & mask];
+            cell.value = values[index];
+            cell.sequence.store(pos+index+1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    uint64_t try_pop_bulk(value_t * values, uint64_t count) {
+        uint64_t pos;
+        count = claim(*dequeue_pos, 1, count, pos);
+        for (uint64_t index = 0; index < count; index++) {
+            cell_t& cell = buffer[(pos+index) & mask];
+            values[index] = std::move(cell.value);
+            cell.sequence.store(pos+index+mask+1, std::memory_order_release);
+        }
+        return count;
+    }
+
+    template <
+        typename arg_t>
+    void push(arg_t&& value) {
+        backoff_t backoff;
+        while (!try_push(std::forward<arg_t>(value)))
+            backoff();
+    }
+
+    value_t pop() {
+        value_t value;
+        backoff_t backoff;
+        while (!try_pop(value))
+            backoff();
+        return value;
+    }
+
+    uint64_t size_approx() const {
+        const uint64_t tail = enqueue_pos->load(std::memory_order_relaxed);
+        const uint64_t head = dequeue_pos->load(std::memory_order_relaxed);
+        return tail > head ? tail-head : 0;
+    }
+
+    uint64_t capacity() const {
+        return buffer.size();
+    }
+};
+
+#endif
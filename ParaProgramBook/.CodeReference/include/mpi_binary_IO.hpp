@@ -0,0 +1,190 @@
+#ifndef MPI_BINARY_IO_HPP
+#define MPI_BINARY_IO_HPP
+
+#include <string>
+#include <cstdint>
+
+#include "mpi.h"
+#include "binary_IO.hpp"    // matrix_header_t
+
+// Collective MPI-IO for the matrix files of binary_IO.hpp: every process
+// reads or writes only its own block through a subarray file view, no
+// process ever holds the whole matrix. All processes of comm must call.
+
+template <
+    typename value_t>
+MPI_Datatype mpi_type();
+
+template <>
+inline MPI_Datatype mpi_type<float>() {
+    return MPI_FLOAT;
+}
+
+template <>
+inline MPI_Datatype mpi_type<double>() {
+    return MPI_DOUBLE;
+}
+
+// process 0 reads the header and broadcasts it, false if the file
+// cannot be opened or is no matrix file
+inline bool read_matrix_header(
+    const std::string& filename,
+    MPI_Comm comm,
+    matrix_header_t& header) {
+
+    int rank, valid = 0;
+    MPI_Comm_rank(comm, &rank);
+
+    if (!rank) {
+        MPI_File file;
+        if (MPI_File_open(MPI_COMM_SELF, filename.c_str(), MPI_MODE_RDONLY,
+                          MPI_INFO_NULL, &file) == MPI_SUCCESS) {
+            MPI_Status status;
+            int count = 0;
+            MPI_File_read_at(file, 0, &header, sizeof(header), MPI_BYTE,
+                             &status);
+            MPI_Get_count(&status, MPI_BYTE, &count);
+            valid = count == int(sizeof(header)) && is_matrix_header(header);
+            MPI_File_close(&file);
+        }
+    }
+
+    MPI_Bcast(&valid, 1, MPI_INT, 0, comm);
+    if (valid)
+        MPI_Bcast(&header, sizeof(header), MPI_BYTE, 0, comm);
+    return valid;
+}
+
+// The block [row0, row0+block_rows) x [col0, col0+block_cols) of the
+// rows x cols payload as file type, and its layout in memory (rows
+// with a leading dimension of ld values) as memory type
+template <
+    typename value_t>
+void make_block_types(
+    uint64_t rows,
+    uint64_t cols,
+    int row0,
+    int col0,
+    int block_rows,
+    int block_cols,
+    int ld,
+    MPI_Datatype& file_type,
+    MPI_Datatype& memory_type) {
+
+    const int sizes[2] = {int(rows), int(cols)};
+    const int subsizes[2] = {block_rows, block_cols};
+    const int starts[2] = {row0, col0};
+
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C,
+                             mpi_type<value_t>(), &file_type);
+    MPI_Type_vector(block_rows, block_cols, ld, mpi_type<value_t>(),
+                    &memory_type);
+    MPI_Type_commit(&file_type);
+    MPI_Type_commit(&memory_type);
+}
+
+// writes the header (process 0) and the blocks of all processes with
+// one collective call, empty blocks take part with zero values
+template <
+    typename value_t>
+bool write_matrix_block(
+    const std::string& filename,
+    MPI_Comm comm,
+    const value_t * block,
+    uint64_t rows,
+    uint64_t cols,
+    int row0,
+    int col0,
+    int block_rows,
+    int block_cols,
+    int ld,
+    uint64_t iteration=0) {
+
+    int rank, success = 1;
+    MPI_Comm_rank(comm, &rank);
+
+    MPI_File file;
+    if (MPI_File_open(comm, filename.c_str(),
+                      MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                      &file) != MPI_SUCCESS)
+        return false;
+
+    // a longer old file would keep its tail otherwise
+    const matrix_header_t header = make_matrix_header(rows, cols,
+                                       sizeof(value_t), iteration);
+    MPI_File_set_size(file, sizeof(header)+rows*cols*sizeof(value_t));
+
+    if (!rank)
+        success = MPI_File_write_at(file, 0, &header, sizeof(header),
+                      MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS;
+
+    const bool empty = block_rows < 1 || block_cols < 1;
+    MPI_Datatype file_type = mpi_type<value_t>(), memory_type;
+    if (!empty)
+        make_block_types<value_t>(rows, cols, row0, col0, block_rows,
+                                  block_cols, ld, file_type, memory_type);
+
+    MPI_File_set_view(file, sizeof(header), mpi_type<value_t>(), file_type,
+                      "native", MPI_INFO_NULL);
+    success &= MPI_File_write_at_all(file, 0, block, empty ? 0 : 1,
+                   empty ? mpi_type<value_t>() : memory_type,
+                   MPI_STATUS_IGNORE) == MPI_SUCCESS;
+    MPI_File_close(&file);
+
+    if (!empty) {
+        MPI_Type_free(&file_type);
+        MPI_Type_free(&memory_type);
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &success, 1, MPI_INT, MPI_LAND, comm);
+    return success;
+}
+
+// reads the block of every process from a file whose header has been
+// read with read_matrix_header, false if the value type differs
+template <
+    typename value_t>
+bool read_matrix_block(
+    const std::string& filename,
+    MPI_Comm comm,
+    value_t * block,
+    const matrix_header_t& header,
+    int row0,
+    int col0,
+    int block_rows,
+    int block_cols,
+    int ld) {
+
+    if (header.value_size != sizeof(value_t))
+        return false;
+
+    int success = 1;
+    MPI_File file;
+    if (MPI_File_open(comm, filename.c_str(), MPI_MODE_RDONLY,
+                      MPI_INFO_NULL, &file) != MPI_SUCCESS)
+        return false;
+
+    const bool empty = block_rows < 1 || block_cols < 1;
+    MPI_Datatype file_type = mpi_type<value_t>(), memory_type;
+    if (!empty)
+        make_block_types<value_t>(header.rows, header.cols, row0, col0,
+                                  block_rows, block_cols, ld, file_type,
+                                  memory_type);
+
+    MPI_File_set_view(file, sizeof(header), mpi_type<value_t>(), file_type,
+                      "native", MPI_INFO_NULL);
+    success = MPI_File_read_at_all(file, 0, block, empty ? 0 : 1,
+                  empty ? mpi_type<value_t>() : memory_type,
+                  MPI_STATUS_IGNORE) == MPI_SUCCESS;
+    MPI_File_close(&file);
+
+    if (!empty) {
+        MPI_Type_free(&file_type);
+        MPI_Type_free(&memory_type);
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &success, 1, MPI_INT, MPI_LAND, comm);
+    return success;
+}
+
+#endif
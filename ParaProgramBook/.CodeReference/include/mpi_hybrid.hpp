@@ -0,0 +1,69 @@
+#ifndef MPI_HYBRID_HPP
+#define MPI_HYBRID_HPP
+
+#include <cstdint>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "mpi.h"
+
+// Hybrid MPI + threads: one process per NUMA node (e.g. mpirun --map-by
+// ppr:1:numa --bind-to numa) whose worker threads share the data of the
+// process, so every node keeps one copy of replicated data instead of
+// one per core. The thread level says who may call MPI: with
+// MPI_THREAD_FUNNELED only the main thread, with MPI_THREAD_SERIALIZED
+// any thread as long as no two of them call at the same time.
+
+// initializes MPI with at least the thread level required, all
+// processes abort if the library cannot provide it
+inline void init_mpi_threads(
+    int& argc,
+    char**& argv,
+    int required) {
+
+    int provided, rank;
+    MPI_Init_thread(&argc, &argv, required, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    if (provided < required) {
+        if (!rank)
+            std::cout << "ERROR: MPI provides thread level " << provided
+                      << " instead of " << required << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+}
+
+// peak resident memory of the calling process in bytes (VmHWM of
+// /proc/self/status), 0 where there is no such file
+inline uint64_t peak_memory_bytes() {
+
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:"))
+            continue;
+        std::istringstream fields(line.substr(6));
+        uint64_t kilobytes = 0;
+        fields >> kilobytes;
+        return kilobytes << 10;
+    }
+    return 0;
+}
+
+// sum of the peak memory of the processes of comm that share the node
+// of the caller, i.e. what the node needs for its share of the job
+inline uint64_t node_peak_memory_bytes(
+    MPI_Comm comm) {
+
+    MPI_Comm node;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+
+    unsigned long long mine = peak_memory_bytes(), sum;
+    MPI_Allreduce(&mine, &sum, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, node);
+    MPI_Comm_free(&node);
+    return sum;
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef SHARDED_COUNTER_HPP
+#define SHARDED_COUNTER_HPP
+
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <sched.h>
+
+#include "cache_aligned.hpp"   // padded_array_t, FALSE_SHARING_WRITE
+
+// A statistics counter split into one cache line per core: increments
+// go to the shard of the core the thread is running on, so concurrent
+// increments from different cores never touch the same line. The core
+// is looked up with sched_getcpu(), cached and refreshed every 256
+// increments; a migrated thread merely shares a shard for a while,
+// the relaxed fetch_add keeps the count correct in that case.
+template <
+    typename value_t=uint64_t>
+class sharded_counter_t {
+
+private:
+    padded_array_t<std::atomic<value_t>> shards;
+    uint64_t mask;
+
+    static uint64_t num_cores() {
+        const uint64_t cores = std::thread::hardware_concurrency();
+        return cores ? cores : 1;
+    }
+
+    static uint64_t power_of_two(uint64_t num_shards) {
+        uint64_t size = 1;
+        while (size < num_shards)
+            size <<= 1;
+        return size;
+    }
+
+    // the shard of the calling thread, re-queried every refresh increments
+    uint64_t shard_index() const {
+
+        static const uint32_t refresh = 256;
+        static thread_local uint32_t countdown = 0;
+        static thread_local uint64_t core = 0;
+
+        if (countdown-- == 0) {
+            const int cpu = sched_getcpu();
+            core = cpu < 0 ? std::hash<std::thread::id>()(
+                                 std::this_thread::get_id()) : cpu;
+            countdown = refresh-1;
+        }
+
+        return core & mask;
+    }
+
+public:
+    // num_shards is rounded up to a power of two
+    sharded_counter_t(
+        uint64_t num_shards=num_cores()) :
+        shards(power_of_two(num_shards), value_t(0)),
+        mask(shards.size()-1) {}
+
+    // the fast path: one uncontended relaxed atomic add
+    void add(
+        const value_t& operand=value_t(1)) {
+        auto& shard = shards[shard_index()];
+        FALSE_SHARING_WRITE(&shard);
+        shard.fetch_add(operand, std::memory_order_relaxed);
+    }
+
+    void operator++() {
+        add();
+    }
+
+    void operator++(int) {
+        add();
+    }
+
+    // The sum of all shards. Exact if all increments happen before the
+    // call (e.g. the incrementing threads are joined), otherwise it lies
+    // between the counts at the beginning and the end of the call.
+    value_t read() const {
+        value_t result = 0;
+        for (uint64_t id = 0; id < shards.size(); id++)
+            result += shards[id].load(std::memory_order_relaxed);
+        return result;
+    }
+
+    // not thread-safe with respect to concurrent increments
+    void reset() {
+        for (uint64_t id = 0; id < shards.size(); id++)
+            shards[id].store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t num_shards() const {
+        return shards.size();
+    }
+};
+
+#endif
@@ -0,0 +1,486 @@
+#ifndef STREAM_IO_HPP
+#define STREAM_IO_HPP
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+#include <condition_variable>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "hpc_helpers.hpp"  // SDIV
+
+// io_uring is used through raw system calls so that no
+// additional library (liburing) is needed at link time
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>) && !defined(NO_IO_URING)
+        #include <linux/io_uring.h>
+        #include <sys/syscall.h>
+        #define STREAM_IO_HAS_URING
+    #endif
+#endif
+
+#ifdef STREAM_IO_HAS_URING
+// minimal single-threaded io_uring wrapper: one submission
+// queue, one completion queue, read requests only
+class uring_t {
+
+private:
+
+    int ring_fd;
+    void * sq_ptr, * cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+
+    // pointers into the shared submission/completion rings
+    unsigned * sq_head, * sq_tail, * sq_mask, * sq_array;
+    unsigned * cq_head, * cq_tail, * cq_mask;
+    io_uring_sqe * sqes;
+    io_uring_cqe * cqes;
+
+public:
+    uring_t() : ring_fd(-1), sq_ptr(MAP_FAILED), cq_ptr(MAP_FAILED),
+                sqes(nullptr) {}
+
+    ~uring_t() {
+        if (sqes)
+            munmap(sqes, sqes_size);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+            munmap(cq_ptr, cq_size);
+        if (sq_ptr != MAP_FAILED)
+            munmap(sq_ptr, sq_size);
+        if (ring_fd >= 0)
+            close(ring_fd);
+    }
+
+    // returns false if the kernel refuses io_uring (old kernel,
+    // seccomp filters in containers, ...) -> use the fallback
+    bool init(unsigned entries) {
+
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+        if (ring_fd < 0)
+            return false;
+
+        sq_size = params.sq_off.array+params.sq_entries*sizeof(unsigned);
+        cq_size = params.cq_off.cqes+params.cq_entries*sizeof(io_uring_cqe);
+
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap)
+            sq_size = cq_size = std::max(sq_size, cq_size);
+
+        sq_ptr = mmap(0, sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED)
+            return false;
+
+        cq_ptr = single_mmap ? sq_ptr :
+                 mmap(0, cq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED)
+            return false;
+
+        sqes_size = params.sq_entries*sizeof(io_uring_sqe);
+        void * sqes_ptr = mmap(0, sqes_size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE,
+                               ring_fd, IORING_OFF_SQES);
+        if (sqes_ptr == MAP_FAILED)
+            return false;
+        sqes = static_cast<io_uring_sqe*>(sqes_ptr);
+
+        auto sq_base = static_cast<char*>(sq_ptr);
+        sq_head  = reinterpret_cast<unsigned*>(sq_base+params.sq_off.head);
+        sq_tail  = reinterpret_cast<unsigned*>(sq_base+params.sq_off.tail);
+        sq_mask  = reinterpret_cast<unsigned*>(sq_base+params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq_base+params.sq_off.array);
+
+        auto cq_base = static_cast<char*>(cq_ptr);
+        cq_head  = reinterpret_cast<unsigned*>(cq_base+params.cq_off.head);
+        cq_tail  = reinterpret_cast<unsigned*>(cq_base+params.cq_off.tail);
+        cq_mask  = reinterpret_cast<unsigned*>(cq_base+params.cq_off.ring_mask);
+        cqes     = reinterpret_cast<io_uring_cqe*>(cq_base+params.cq_off.cqes);
+
+        return true;
+    }
+
+    // enqueue a read of length bytes at offset into buffer
+    bool submit_read(
+        int file,
+        void * buffer,
+        unsigned length,
+        uint64_t offset,
+        uint64_t tag) {
+
+        const unsigned tail  = *sq_tail;
+        const unsigned index = tail & *sq_mask;
+
+        io_uring_sqe * sqe = &sqes[index];
+        memset(sqe, 0, sizeof(io_uring_sqe));
+        sqe->opcode    = IORING_OP_READ;
+        sqe->fd        = file;
+        sqe->addr      = reinterpret_cast<uint64_t>(buffer);
+        sqe->len       = length;
+        sqe->off       = offset;
+        sqe->user_data = tag;
+
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail+1, __ATOMIC_RELEASE);
+
+        return syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0) == 1;
+    }
+
+    // block until one completion arrives, returns its tag
+    uint64_t wait_completion(int& result) {
+
+        while (true) {
+            const unsigned head = *cq_head;
+            const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+            if (head != tail) {
+                const io_uring_cqe * cqe = &cqes[head & *cq_mask];
+                const uint64_t tag = cqe->user_data;
+                result = cqe->res;
+                __atomic_store_n(cq_head, head+1, __ATOMIC_RELEASE);
+                return tag;
+            }
+
+            syscall(__NR_io_uring_enter, ring_fd, 0, 1,
+                    IORING_ENTER_GETEVENTS, nullptr, 0);
+        }
+    }
+};
+#endif
+
+// Streams a row-major binary file of shape rows x cols in blocks of
+// block_rows rows through a ring of num_buffers page-aligned, pinned
+// buffers. While the caller computes on block b, blocks b+1, ...,
+// b+num_buffers-1 are read in the background (io_uring if available,
+// otherwise a dedicated reader thread issuing pread).
+template <
+    typename value_t,
+    typename index_t>
+class block_reader_t {
+
+private:
+
+    int file;
+    const index_t rows, cols, block_rows, num_buffers, row_offset;
+    const index_t num_blocks;
+
+    // the ring of pinned buffers
+    std::vector<value_t*> buffers;
+    const size_t buffer_bytes;
+
+    // number of blocks handed out to and given back by the caller
+    index_t acquired, released;
+
+    // thread-based fallback
+    std::thread reader;
+    std::mutex mutex;
+    std::condition_variable cv_filled, cv_released;
+    index_t filled;
+    bool stop_reader, failed;
+
+    #ifdef STREAM_IO_HAS_URING
+    uring_t uring;
+    bool use_uring;
+    std::vector<size_t> done_bytes;
+    index_t in_flight;  // submitted reads whose completion is pending
+    #endif
+
+    index_t block_lower(index_t block) const {
+        return block*block_rows;
+    }
+
+    index_t block_upper(index_t block) const {
+        return std::min(rows, (block+1)*block_rows);
+    }
+
+    size_t block_bytes(index_t block) const {
+        return sizeof(value_t)*cols*(block_upper(block)-block_lower(block));
+    }
+
+    uint64_t block_offset(index_t block) const {
+        return sizeof(value_t)*cols*(row_offset+block_lower(block));
+    }
+
+    // read a whole block with pread (loops over short reads)
+    bool read_block(index_t block) {
+
+        char * buffer = reinterpret_cast<char*>(buffers[block%num_buffers]);
+        const size_t length = block_bytes(block);
+        const uint64_t offset = block_offset(block);
+
+        size_t done = 0;
+        while (done < length) {
+            const ssize_t bytes = pread(file, buffer+done,
+                                        length-done, offset+done);
+            if (bytes <= 0)
+                return false;
+            done += bytes;
+        }
+
+        return true;
+    }
+
+    #ifdef STREAM_IO_HAS_URING
+    void submit_block(index_t block) {
+
+        const index_t slot = block%num_buffers;
+        char * buffer = reinterpret_cast<char*>(buffers[slot]);
+        const size_t length = block_bytes(block);
+        const size_t done = done_bytes[slot];
+
+        if (!uring.submit_read(file, buffer+done, length-done,
+                               block_offset(block)+done, block))
+            throw std::runtime_error("io_uring submission failed");
+        in_flight++;
+    }
+
+    void wait_block(index_t block) {
+
+        const index_t slot = block%num_buffers;
+
+        while (done_bytes[slot] < block_bytes(block)) {
+
+            int result;
+            const index_t other = uring.wait_completion(result);
+            in_flight--;
+            if (result <= 0)
+                throw std::runtime_error("io_uring read failed");
+
+            // short reads are resubmitted for the remainder
+            const index_t other_slot = other%num_buffers;
+            done_bytes[other_slot] += result;
+            if (done_bytes[other_slot] < block_bytes(other))
+                submit_block(other);
+        }
+    }
+    #endif
+
+    // waits for the reads still in flight whatever their outcome, then
+    // frees the buffers and closes the file: never throws, hence safe
+    // in the destructor and on a failing constructor
+    void release_resources() noexcept {
+
+        #ifdef STREAM_IO_HAS_URING
+        if (use_uring)
+            while (in_flight > 0) {
+                int result;
+                uring.wait_completion(result);
+                in_flight--;
+            }
+        #endif
+
+        for (auto buffer : buffers) {
+            munlock(buffer, buffer_bytes);
+            free(buffer);
+        }
+        buffers.clear();
+
+        close(file);
+    }
+
+    void reader_loop() {
+
+        for (index_t block = 0; block < num_blocks; block++) {
+
+            { // wait until the slot of this block is free again
+                std::unique_lock<std::mutex> unique_lock(mutex);
+                cv_released.wait(unique_lock, [&] () -> bool {
+                    return stop_reader || block < released+num_buffers;
+                });
+                if (stop_reader)
+                    return;
+            }
+
+            const bool success = read_block(block);
+
+            { // publish the block
+                std::lock_guard<std::mutex> lock_guard(mutex);
+                failed = !success;
+                filled = block+1;
+            }
+            cv_filled.notify_one();
+
+            if (!success)
+                return;
+        }
+    }
+
+public:
+    block_reader_t(
+        std::string filename,
+        index_t rows_,
+        index_t cols_,
+        index_t block_rows_,
+        index_t num_buffers_=2,
+        index_t row_offset_=0) :
+        rows(rows_), cols(cols_),
+        block_rows(block_rows_), num_buffers(num_buffers_),
+        row_offset(row_offset_),
+        num_blocks(SDIV(rows_, block_rows_)),
+        buffer_bytes(SDIV(sizeof(value_t)*cols_*block_rows_, 4096)*4096),
+        acquired(0), released(0), filled(0),
+        stop_reader(false), failed(false) {
+
+        #ifdef STREAM_IO_HAS_URING
+        use_uring = false;
+        in_flight = 0;
+        #endif
+
+        if (block_rows < 1 || num_buffers < 1)
+            throw std::runtime_error("block_reader_t: empty block or ring");
+
+        file = open(filename.c_str(), O_RDONLY);
+        if (file < 0)
+            throw std::runtime_error("block_reader_t: cannot open "+filename);
+
+        // tell the kernel we read front to back
+        posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        // the destructor does not run if the constructor throws,
+        // hence give back what has been acquired so far
+        try {
+            // page-aligned buffers, pinned if the memlock limit allows
+            buffers.reserve(num_buffers);
+            for (index_t slot = 0; slot < num_buffers; slot++) {
+                void * buffer = nullptr;
+                if (posix_memalign(&buffer, 4096, buffer_bytes))
+                    throw std::bad_alloc();
+                mlock(buffer, buffer_bytes);
+                buffers.push_back(static_cast<value_t*>(buffer));
+            }
+
+            #ifdef STREAM_IO_HAS_URING
+            use_uring = uring.init(num_buffers);
+            if (use_uring) {
+                done_bytes.resize(num_buffers, 0);
+                for (index_t block = 0;
+                     block < std::min(num_buffers, num_blocks); block++)
+                    submit_block(block);
+                return;
+            }
+            #endif
+
+            reader = std::thread(&block_reader_t::reader_loop, this);
+        } catch (...) {
+            release_resources();
+            throw;
+        }
+    }
+
+    ~block_reader_t() {
+
+        if (reader.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock_guard(mutex);
+                stop_reader = true;
+            }
+            cv_released.notify_one();
+            reader.join();
+        }
+
+        // drains reads still in flight before freeing their buffers
+        release_resources();
+    }
+
+    // block until the next block is in memory, returns the number
+    // of rows in it (0 if the file is exhausted) and its first row
+    index_t acquire(
+        const value_t *& block,
+        index_t& lower) {
+
+        if (acquired != released)
+            throw std::runtime_error("block_reader_t: release first");
+
+        if (acquired == num_blocks)
+            return 0;
+
+        #ifdef STREAM_IO_HAS_URING
+        if (use_uring)
+            wait_block(acquired);
+        else
+        #endif
+        {
+            std::unique_lock<std::mutex> unique_lock(mutex);
+            cv_filled.wait(unique_lock, [&] () -> bool {
+                return failed || filled > acquired;
+            });
+            if (failed)
+                throw std::runtime_error("block_reader_t: read failed");
+        }
+
+        block = buffers[acquired%num_buffers];
+        lower = block_lower(acquired);
+
+        return block_upper(acquired++)-lower;
+    }
+
+    // hand the last acquired block back to the ring
+    void release() {
+
+        #ifdef STREAM_IO_HAS_URING
+        if (use_uring) {
+            done_bytes[released%num_buffers] = 0;
+            if (released+num_buffers < num_blocks)
+                submit_block(released+num_buffers);
+            released++;
+            return;
+        }
+        #endif
+
+        {
+            std::lock_guard<std::mutex> lock_guard(mutex);
+            released++;
+        }
+        cv_released.notify_one();
+    }
+
+    bool uses_io_uring() const {
+        #ifdef STREAM_IO_HAS_URING
+        return use_uring;
+        #else
+        return false;
+        #endif
+    }
+};
+
+// convenience wrapper: calls func(block, lower, upper) for each
+// block of rows [lower, upper) of the file in ascending order
+template <
+    typename value_t,
+    typename index_t,
+    typename funct_t>
+void for_each_block(
+    std::string filename,
+    index_t rows,
+    index_t cols,
+    index_t block_rows,
+    funct_t func,
+    index_t num_buffers=2,
+    index_t row_offset=0) {
+
+    block_reader_t<value_t, index_t> reader(filename, rows, cols,
+                                            block_rows, num_buffers,
+                                            row_offset);
+
+    const value_t * block;
+    index_t lower, length;
+
+    while ((length = reader.acquire(block, lower))) {
+        func(block, lower, lower+length);
+        reader.release();
+    }
+}
+
+#endif
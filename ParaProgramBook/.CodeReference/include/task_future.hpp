@@ -0,0 +1,363 @@
+#ifndef TASK_FUTURE_HPP
+#define TASK_FUTURE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <exception>
+#include <stdexcept>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+// Futures with continuations: then(), when_all() and when_any() do not
+// wait for anything, they register a callback in the shared state and
+// the callback is enqueued on the thread pool once the value is set.
+// Only get() blocks, i.e. the final consumer of a task graph.
+
+// hands a ready-to-run closure to an executor (e.g. a ThreadPool)
+typedef std::function<void(std::function<void(void)>)> scheduler_t;
+
+template <
+    typename pool_t>
+scheduler_t make_scheduler(pool_t& pool) {
+    return [&pool] (std::function<void(void)> func) -> void {
+        pool.enqueue(std::move(func));
+    };
+}
+
+// runs the closure on the calling thread, for results that are ready
+// at once and have no pool to inherit
+inline scheduler_t inline_scheduler() {
+    return [] (std::function<void(void)> func) -> void {
+        func();
+    };
+}
+
+// what a future<void> stores
+struct unit_t {};
+
+template <
+    typename value_t>
+using stored_t = typename std::conditional<
+    std::is_void<value_t>::value, unit_t, value_t>::type;
+
+template <
+    typename value_t>
+class future_state_t {
+
+public:
+    typedef stored_t<value_t> storage_t;
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool ready;
+    storage_t value;
+    std::exception_ptr error;
+    std::vector<std::function<void(void)>> continuations;
+
+    void publish() {
+        std::vector<std::function<void(void)>> pending;
+        {
+            std::lock_guard<std::mutex> lock_guard(mutex);
+            ready = true;
+            pending.swap(continuations);
+        }
+        cv.notify_all();
+        for (auto& continuation : pending)
+            schedule(std::move(continuation));
+    }
+
+public:
+    scheduler_t schedule;
+
+    future_state_t(scheduler_t schedule_) :
+        ready(false), value(), schedule(std::move(schedule_)) {}
+
+    void set_value(storage_t value_) {
+        value = std::move(value_);
+        publish();
+    }
+
+    void set_error(std::exception_ptr error_) {
+        error = error_;
+        publish();
+    }
+
+    // run continuation on the pool once ready (at once if it already is)
+    void on_ready(std::function<void(void)> continuation) {
+        {
+            std::lock_guard<std::mutex> lock_guard(mutex);
+            if (!ready) {
+                continuations.emplace_back(std::move(continuation));
+                return;
+            }
+        }
+        schedule(std::move(continuation));
+    }
+
+    bool is_ready() {
+        std::lock_guard<std::mutex> lock_guard(mutex);
+        return ready;
+    }
+
+    // only valid once ready
+    const storage_t& stored() const { return value; }
+    std::exception_ptr failure() const { return error; }
+
+    void wait() {
+        std::unique_lock<std::mutex> unique_lock(mutex);
+        cv.wait(unique_lock, [this] () { return ready; });
+    }
+};
+
+// evaluates func(args...) and stores the result (or the exception)
+template <
+    typename value_t,
+    typename funct_t,
+    typename ... args_t>
+typename std::enable_if<!std::is_void<value_t>::value>::type
+fulfill(future_state_t<value_t>& state, funct_t& func, args_t&& ... args) {
+    try {
+        state.set_value(func(std::forward<args_t>(args)...));
+    } catch (...) {
+        state.set_error(std::current_exception());
+    }
+}
+
+template <
+    typename value_t,
+    typename funct_t,
+    typename ... args_t>
+typename std::enable_if<std::is_void<value_t>::value>::type
+fulfill(future_state_t<value_t>& state, funct_t& func, args_t&& ... args) {
+    try {
+        func(std::forward<args_t>(args)...);
+        state.set_value(unit_t());
+    } catch (...) {
+        state.set_error(std::current_exception());
+    }
+}
+
+template <
+    typename value_t>
+class task_future_t {
+
+public:
+    typedef future_state_t<value_t> state_t;
+
+private:
+    std::shared_ptr<state_t> state;
+
+    // calls func with the stored value, or without for future<void>
+    template <
+        typename result_t,
+        typename funct_t,
+        typename value_u=value_t>
+    static typename std::enable_if<!std::is_void<value_u>::value>::type
+    forward_value(state_t& source, future_state_t<result_t>& target,
+                  funct_t& func) {
+        fulfill(target, func, source.stored());
+    }
+
+    template <
+        typename result_t,
+        typename funct_t,
+        typename value_u=value_t>
+    static typename std::enable_if<std::is_void<value_u>::value>::type
+    forward_value(state_t&, future_state_t<result_t>& target,
+                  funct_t& func) {
+        fulfill(target, func);
+    }
+
+    template <
+        typename funct_t,
+        typename value_u=value_t>
+    struct result_of_then {
+        typedef typename std::result_of<funct_t(const value_u&)>::type type;
+    };
+
+    template <
+        typename funct_t>
+    struct result_of_then<funct_t, void> {
+        typedef typename std::result_of<funct_t()>::type type;
+    };
+
+public:
+    task_future_t() {}
+
+    task_future_t(std::shared_ptr<state_t> state_) :
+        state(std::move(state_)) {}
+
+    std::shared_ptr<state_t> shared_state() const {
+        return state;
+    }
+
+    bool valid() const {
+        return bool(state);
+    }
+
+    bool is_ready() const {
+        return state->is_ready();
+    }
+
+    // register func(value) to be run on the pool when this is ready,
+    // exceptions skip func and propagate to the returned future
+    template <
+        typename funct_t,
+        typename result_t=typename result_of_then<funct_t>::type>
+    task_future_t<result_t> then(funct_t func) const {
+
+        auto source = state;
+        auto target = std::make_shared<future_state_t<result_t>>(
+                          source->schedule);
+
+        source->on_ready([source, target, func] () mutable -> void {
+            if (source->failure())
+                target->set_error(source->failure());
+            else
+                forward_value(*source, *target, func);
+        });
+
+        return task_future_t<result_t>(target);
+    }
+
+    // the only blocking call: waits and returns (or rethrows)
+    stored_t<value_t> get() const {
+        state->wait();
+        if (state->failure())
+            std::rethrow_exception(state->failure());
+        return state->stored();
+    }
+
+    void wait() const {
+        state->wait();
+    }
+};
+
+// run func(args...) on the pool and return a task_future_t
+template <
+    typename pool_t,
+    typename funct_t,
+    typename ... args_t,
+    typename result_t=typename std::result_of<funct_t(args_t...)>::type>
+task_future_t<result_t> async_on(
+    pool_t& pool,
+    funct_t func,
+    args_t ... args) {
+
+    auto target = std::make_shared<future_state_t<result_t>>(
+                      make_scheduler(pool));
+
+    target->schedule([target, func, args...] () mutable -> void {
+        fulfill(*target, func, args...);
+    });
+
+    return task_future_t<result_t>(target);
+}
+
+// ready once all futures are ready: the vector of their values
+// (or the first exception in input order)
+template <
+    typename value_t>
+task_future_t<std::vector<stored_t<value_t>>> when_all(
+    const std::vector<task_future_t<value_t>>& futures,
+    scheduler_t schedule) {
+
+    typedef std::vector<stored_t<value_t>> result_t;
+    auto target = std::make_shared<future_state_t<result_t>>(schedule);
+
+    if (futures.empty()) {
+        target->set_value(result_t());
+        return task_future_t<result_t>(target);
+    }
+
+    // the last one to finish gathers the values
+    auto remaining = std::make_shared<std::atomic<uint64_t>>(futures.size());
+    auto sources = std::make_shared<std::vector<task_future_t<value_t>>>(
+                       futures);
+
+    for (const auto& future : futures)
+        future.shared_state()->on_ready([=] () -> void {
+            if (remaining->fetch_sub(1) != 1)
+                return;
+
+            result_t values;
+            values.reserve(sources->size());
+            for (const auto& source : *sources) {
+                auto source_state = source.shared_state();
+                if (source_state->failure()) {
+                    target->set_error(source_state->failure());
+                    return;
+                }
+                values.push_back(source_state->stored());
+            }
+            target->set_value(std::move(values));
+        });
+
+    return task_future_t<result_t>(target);
+}
+
+template <
+    typename value_t>
+task_future_t<std::vector<stored_t<value_t>>> when_all(
+    const std::vector<task_future_t<value_t>>& futures) {
+
+    // continuations inherit the pool of the first future, an empty
+    // input is ready at once and has none
+    if (futures.empty())
+        return when_all(futures, inline_scheduler());
+    return when_all(futures, futures[0].shared_state()->schedule);
+}
+
+// ready as soon as one future is ready: its index and value
+// (or its exception), the other results are ignored. Without any
+// future nothing can become ready, the result holds an
+// std::invalid_argument instead
+template <
+    typename value_t>
+task_future_t<std::pair<uint64_t, stored_t<value_t>>> when_any(
+    const std::vector<task_future_t<value_t>>& futures,
+    scheduler_t schedule) {
+
+    typedef std::pair<uint64_t, stored_t<value_t>> result_t;
+    auto target = std::make_shared<future_state_t<result_t>>(schedule);
+
+    if (futures.empty()) {
+        target->set_error(std::make_exception_ptr(
+            std::invalid_argument("when_any of no futures")));
+        return task_future_t<result_t>(target);
+    }
+
+    auto done = std::make_shared<std::atomic<bool>>(false);
+
+    for (uint64_t index = 0; index < futures.size(); index++) {
+        auto source_state = futures[index].shared_state();
+        source_state->on_ready([=] () -> void {
+            if (done->exchange(true))
+                return;
+            if (source_state->failure())
+                target->set_error(source_state->failure());
+            else
+                target->set_value(result_t(index, source_state->stored()));
+        });
+    }
+
+    return task_future_t<result_t>(target);
+}
+
+template <
+    typename value_t>
+task_future_t<std::pair<uint64_t, stored_t<value_t>>> when_any(
+    const std::vector<task_future_t<value_t>>& futures) {
+
+    if (futures.empty())
+        return when_any(futures, inline_scheduler());
+    return when_any(futures, futures[0].shared_state()->schedule);
+}
+
+#endif
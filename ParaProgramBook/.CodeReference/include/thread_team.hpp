@@ -0,0 +1,153 @@
+#ifndef THREAD_TEAM_HPP
+#define THREAD_TEAM_HPP
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+
+#include "futex_event.hpp"  // futex_wait, futex_wake, default_spin_limit
+
+// Centralized sense-reversing barrier: the last thread to arrive resets
+// the counter and flips the global sense, everybody else waits until the
+// sense matches its private one (spinning briefly, then on a futex).
+// Flipping the private sense every episode makes the barrier reusable
+// without a second counter.
+class sense_barrier_t {
+
+private:
+    const uint32_t num_threads;
+    cache_aligned_t<std::atomic<uint32_t>> count;
+    cache_aligned_t<std::atomic<uint32_t>> sense;
+    cache_aligned_t<std::atomic<uint32_t>> sleepers;
+    uint32_t spin_limit;
+
+public:
+    sense_barrier_t(
+        uint32_t num_threads_,
+        uint32_t spin_limit_=default_spin_limit()) :
+        num_threads(num_threads_),
+        count(num_threads_),
+        sense(uint32_t(0)),
+        sleepers(uint32_t(0)),
+        spin_limit(spin_limit_) {}
+
+    // local_sense is owned by the calling thread and starts at 0
+    void arrive_and_wait(uint32_t& local_sense) {
+
+        local_sense ^= 1;
+
+        if (count->fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            count->store(num_threads, std::memory_order_relaxed);
+            sense->store(local_sense, std::memory_order_seq_cst);
+            if (sleepers->load(std::memory_order_seq_cst))
+                futex_wake(*sense, INT32_MAX);
+            return;
+        }
+
+        for (uint32_t spin = 0; spin < spin_limit; spin++) {
+            if (sense->load(std::memory_order_acquire) == local_sense)
+                return;
+            cpu_relax();
+        }
+
+        sleepers->fetch_add(1, std::memory_order_seq_cst);
+        while (sense->load(std::memory_order_seq_cst) != local_sense)
+            futex_wait(*sense, local_sense ^ 1);
+        sleepers->fetch_sub(1, std::memory_order_relaxed);
+    }
+};
+
+// Persistent team of num_threads threads (the caller is member 0) that
+// runs phases instead of spawning and joining threads for every call:
+// run(phase) executes phase(id) on all members and returns once all of
+// them are done, run(num_phases, phase) executes phase(id, k) for
+// k = 0..num_phases-1 with a barrier after each phase without returning
+// to the caller in between. Inside a phase barrier(id) synchronizes.
+class thread_team_t {
+
+private:
+    const uint64_t num_threads;
+    sense_barrier_t team_barrier;
+    padded_array_t<uint32_t> senses;
+    std::vector<std::thread> threads;
+
+    // the current job, type-erased without allocation
+    void (*invoke)(const void *, uint64_t);
+    const void * job;
+    bool stop_team;
+
+    template <
+        typename funct_t>
+    static void call(const void * func, uint64_t id) {
+        (*static_cast<const funct_t*>(func))(id);
+    }
+
+public:
+    thread_team_t(
+        uint64_t num_threads_=std::thread::hardware_concurrency()) :
+        num_threads(std::max<uint64_t>(1, num_threads_)),
+        team_barrier(num_threads),
+        senses(num_threads, uint32_t(0)),
+        invoke(nullptr),
+        job(nullptr),
+        stop_team(false) {
+
+        // members wait at the start barrier for the next job,
+        // the barriers order the accesses to job and stop_team
+        auto member = [this] (uint64_t id) -> void {
+            while (true) {
+                barrier(id);
+                if (stop_team)
+                    return;
+                invoke(job, id);
+                barrier(id);
+            }
+        };
+
+        for (uint64_t id = 1; id < num_threads; id++)
+            threads.emplace_back(member, id);
+    }
+
+    ~thread_team_t() {
+        stop_team = true;
+        barrier(0);
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    template <
+        typename funct_t>
+    void run(const funct_t& phase) {
+        invoke = call<funct_t>;
+        job = &phase;
+        barrier(0);
+        phase(0);
+        barrier(0);
+    }
+
+    template <
+        typename funct_t>
+    void run(uint64_t num_phases, const funct_t& phase) {
+        auto phases = [&] (uint64_t id) -> void {
+            for (uint64_t k = 0; k < num_phases; k++) {
+                phase(id, k);
+                barrier(id);
+            }
+        };
+        run(phases);
+    }
+
+    // only to be called by all members of a running job
+    void barrier(uint64_t id) {
+        team_barrier.arrive_and_wait(senses[id]);
+    }
+
+    uint64_t size() const {
+        return num_threads;
+    }
+};
+
+#endif
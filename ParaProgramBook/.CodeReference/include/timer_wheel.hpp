@@ -0,0 +1,303 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <iterator>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+#include "task_future.hpp"  // scheduler_t, make_scheduler
+
+typedef uint64_t timer_id_t;
+
+// Hierarchical timer wheel (4 levels of 256 slots, as in the Linux
+// kernel): a timer lives in the slot of the coarsest level that still
+// resolves its distance to the current tick. Inserting and cancelling
+// is O(1) on intrusive lists, every 256 ticks one slot of the next level
+// is cascaded down. A single driver thread advances the wheel and hands
+// the expired callbacks in batches to a thread pool.
+class timer_wheel_t {
+
+public:
+    typedef std::chrono::steady_clock clock_t;
+
+private:
+    static const uint32_t num_levels = 4;
+    static const uint32_t slot_bits  = 8;
+    static const uint32_t num_slots  = 1 << slot_bits;
+    static const uint32_t slot_mask  = num_slots-1;
+    static const uint32_t nil        = ~0U;
+
+    // timers are recycled, the generation tells stale ids apart
+    struct node_t {
+        std::function<void(void)> callback;
+        uint64_t expiry;      // in ticks
+        uint32_t prev;
+        uint32_t next;
+        uint32_t slot;        // level*num_slots+slot or nil
+        uint32_t generation;
+    };
+
+    std::vector<node_t> nodes;
+    std::vector<uint32_t> free_nodes;
+    std::vector<uint32_t> heads;  // num_levels*num_slots lists
+
+    clock_t::time_point origin;
+    clock_t::duration resolution;
+    uint64_t current;             // last processed tick
+    uint64_t armed;
+
+    scheduler_t dispatch;
+    uint64_t batch_size;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stop_wheel;
+    std::thread driver;
+
+    // the tick at or after time, a timer never fires early
+    uint64_t tick_of(clock_t::time_point time) const {
+        if (time <= origin)
+            return 0;
+        return (time-origin+resolution-clock_t::duration(1))/resolution;
+    }
+
+    // the number of ticks that are over
+    uint64_t elapsed_ticks() const {
+        return (clock_t::now()-origin)/resolution;
+    }
+
+    // overdue timers go into the tick earliest
+    void link(uint32_t index, uint64_t earliest) {
+        node_t& node = nodes[index];
+
+        const uint64_t expiry = std::max(node.expiry, earliest);
+        const uint64_t delta = expiry-current;
+
+        uint32_t level = 0;
+        while (level+1 < num_levels &&
+               delta >= (uint64_t(1) << (slot_bits*(level+1))))
+            level++;
+
+        // beyond the range of the wheel: park in the farthest slot,
+        // it is cascaded (and re-linked) before the timer is due
+        uint64_t position = expiry;
+        if (delta >= (uint64_t(1) << (slot_bits*num_levels)))
+            position = current+(uint64_t(1) << (slot_bits*num_levels))-1;
+
+        node.slot = level*num_slots+
+                    ((position >> (slot_bits*level)) & slot_mask);
+        node.prev = nil;
+        node.next = heads[node.slot];
+        if (node.next != nil)
+            nodes[node.next].prev = index;
+        heads[node.slot] = index;
+    }
+
+    void unlink(uint32_t index) {
+        node_t& node = nodes[index];
+        if (node.prev != nil)
+            nodes[node.prev].next = node.next;
+        else
+            heads[node.slot] = node.next;
+        if (node.next != nil)
+            nodes[node.next].prev = node.prev;
+        node.slot = nil;
+    }
+
+    void release(uint32_t index) {
+        nodes[index].callback = nullptr;
+        nodes[index].generation++;
+        free_nodes.push_back(index);
+        armed--;
+    }
+
+    // re-link all timers of a slot, they end up on finer levels
+    // (or in the slot of the tick that is being processed)
+    void cascade(uint32_t level) {
+        const uint32_t slot = level*num_slots+
+                              ((current >> (slot_bits*level)) & slot_mask);
+        uint32_t index = heads[slot];
+        heads[slot] = nil;
+        while (index != nil) {
+            const uint32_t next = nodes[index].next;
+            link(index, current);
+            index = next;
+        }
+    }
+
+    // process one tick, expired callbacks are moved to expired
+    void advance(std::vector<std::function<void(void)>>& expired) {
+        current++;
+
+        // cascade coarse levels whose slot boundary we crossed,
+        // the coarsest first since it refills the finer ones
+        uint32_t levels = 1;
+        while (levels < num_levels &&
+               (current & ((uint64_t(1) << (slot_bits*levels))-1)) == 0)
+            levels++;
+        for (uint32_t level = levels-1; level > 0; level--)
+            cascade(level);
+
+        uint32_t index = heads[current & slot_mask];
+        heads[current & slot_mask] = nil;
+        while (index != nil) {
+            const uint32_t next = nodes[index].next;
+            nodes[index].slot = nil;
+            expired.emplace_back(std::move(nodes[index].callback));
+            release(index);
+            index = next;
+        }
+    }
+
+    void run_batches(std::vector<std::function<void(void)>>& expired) {
+        for (uint64_t lower = 0; lower < expired.size(); lower += batch_size) {
+            const uint64_t upper = std::min<uint64_t>(lower+batch_size,
+                                                      expired.size());
+            auto batch = std::make_shared<
+                std::vector<std::function<void(void)>>>(
+                    std::make_move_iterator(expired.begin()+lower),
+                    std::make_move_iterator(expired.begin()+upper));
+            dispatch([batch] () -> void {
+                for (auto& callback : *batch)
+                    callback();
+            });
+        }
+        expired.clear();
+    }
+
+    void drive() {
+        std::vector<std::function<void(void)>> expired;
+        std::unique_lock<std::mutex> unique_lock(mutex);
+
+        while (!stop_wheel) {
+
+            // nothing armed: sleep until a timer is added
+            if (armed == 0) {
+                cv.wait(unique_lock, [this] () {
+                    return stop_wheel || armed > 0;
+                });
+                continue;
+            }
+
+            // sleep until the next tick is over
+            cv.wait_until(unique_lock, origin+(current+1)*resolution);
+
+            const uint64_t now = elapsed_ticks();
+            while (current < now && armed > 0)
+                advance(expired);
+            if (armed == 0)
+                current = std::max(current, now);
+
+            if (!expired.empty()) {
+                unique_lock.unlock();
+                run_batches(expired);
+                unique_lock.lock();
+            }
+        }
+    }
+
+public:
+    template <
+        typename pool_t>
+    timer_wheel_t(
+        pool_t& pool,
+        clock_t::duration resolution_=std::chrono::milliseconds(1),
+        uint64_t batch_size_=64) :
+        heads(num_levels*num_slots, nil),
+        origin(clock_t::now()),
+        resolution(resolution_),
+        current(0),
+        armed(0),
+        dispatch(make_scheduler(pool)),
+        batch_size(batch_size_),
+        stop_wheel(false) {
+
+        driver = std::thread([this] () { drive(); });
+    }
+
+    // pending timers are dropped
+    ~timer_wheel_t() {
+        {
+            std::lock_guard<std::mutex> lock_guard(mutex);
+            stop_wheel = true;
+        }
+        cv.notify_one();
+        driver.join();
+    }
+
+    timer_id_t schedule_at(
+        clock_t::time_point time,
+        std::function<void(void)> callback) {
+
+        timer_id_t id;
+        bool wake_driver;
+        {
+            std::lock_guard<std::mutex> lock_guard(mutex);
+
+            uint32_t index;
+            if (free_nodes.empty()) {
+                index = nodes.size();
+                nodes.push_back(node_t{nullptr, 0, nil, nil, nil, 0});
+            } else {
+                index = free_nodes.back();
+                free_nodes.pop_back();
+            }
+
+            // an idle wheel has not been advanced
+            if (armed == 0)
+                current = std::max(current, elapsed_ticks());
+
+            nodes[index].callback = std::move(callback);
+            nodes[index].expiry = tick_of(time);
+            link(index, current+1);
+            wake_driver = armed++ == 0;
+            id = (uint64_t(nodes[index].generation) << 32) | index;
+        }
+
+        if (wake_driver)
+            cv.notify_one();
+
+        return id;
+    }
+
+    template <
+        typename rep_t,
+        typename period_t>
+    timer_id_t schedule_after(
+        std::chrono::duration<rep_t, period_t> delay,
+        std::function<void(void)> callback) {
+        return schedule_at(clock_t::now()+delay, std::move(callback));
+    }
+
+    // false if the timer already fired (or was cancelled before)
+    bool cancel(
+        timer_id_t id) {
+
+        const uint32_t index = id & 0xFFFFFFFF;
+        const uint32_t generation = id >> 32;
+
+        std::lock_guard<std::mutex> lock_guard(mutex);
+        if (index >= nodes.size() ||
+            nodes[index].generation != generation ||
+            nodes[index].slot == nil)
+            return false;
+
+        unlink(index);
+        release(index);
+        return true;
+    }
+
+    uint64_t size() {
+        std::lock_guard<std::mutex> lock_guard(mutex);
+        return armed;
+    }
+};
+
+#endif